@@ -17,6 +17,7 @@
 #include <boost/exception/all.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/unordered_map.hpp>
 
@@ -29,13 +30,14 @@ namespace HSFC
 
 /*****************************************************************************************
  * Player represents a GDL role.
+ *
+ * A Player is a plain handle that copies like an integer. It refers to its Game without
+ * owning it so it must not outlive the Game.
  *****************************************************************************************/
 class Player
 {
 public:
-    Player(const Player& other);
     Player(Game& game, const PortablePlayer& pp);
-    Player& operator=(const Player& other);
 
     bool operator==(const Player& other) const;
     bool operator!=(const Player& other) const;
@@ -49,11 +51,16 @@ private:
     friend class State;
     friend class Game;
     friend class PortablePlayer;
+    friend class PlayoutStats;
+    friend class UCTSearch;
+    friend class JointMoves;
+    friend class JointMoveArray;
+    friend class JointGoalArray;
     friend std::ostream& operator<<(std::ostream& os, const Player& player);
 
-    boost::shared_ptr<const HSFCManager> manager_;
+    const HSFCManager* manager_;
     unsigned int roleid_;
-    Player(boost::shared_ptr<const HSFCManager> manager, unsigned int roleid);
+    Player(const HSFCManager* manager, unsigned int roleid);
 };
 
 std::size_t hash_value(const Player& player); /* can be a key in boost::unordered_*  */
@@ -63,14 +70,15 @@ std::ostream& operator<<(std::ostream& os, const Player& player);
  * Move class.
  * Note: To clear any ambiguity Move represents the move as independent from a player,
  * and NOT the move as taken by a player.
+ *
+ * A Move is a plain handle that copies like an integer. It refers to its Game without
+ * owning it so it must not outlive the Game. The text of a move is only produced when
+ * it is printed.
  *****************************************************************************************/
 class Move
 {
 public:
-    Move(const Move& other);
     Move(Game& game, const PortableMove& pm);
-    ~Move();
-    Move& operator=(const Move& other);
 
     bool operator==(const Move& other) const;
     bool operator!=(const Move& other) const;
@@ -78,14 +86,23 @@ public:
     std::string tostring() const;
     std::size_t hash_value() const;
 
+    /*
+     * The engine's ID for this move, which is how a playout policy (hsfcPolicy) sees
+     * it. The ID includes the player that makes the move.
+     */
+    unsigned int relationid() const;
+
 private:
     friend class State;
     friend class PortableMove;
+    friend class UCTSearch;
+    friend class JointMoves;
+    friend class JointMoveArray;
     friend std::ostream& operator<<(std::ostream& os, const Move& move);
 
-    boost::shared_ptr<HSFCManager> manager_;
-    hsfcLegalMove move_;
-    Move(boost::shared_ptr<HSFCManager> manager, const hsfcLegalMove& move);
+    const HSFCManager* manager_;
+    hsfcLegalMove move_;    // The text is always NULL
+    Move(const HSFCManager* manager, const hsfcLegalMove& move);
 };
 
 std::size_t hash_value(const Move& move); /* can be a key in boost::unordered_*  */
@@ -97,13 +114,11 @@ std::ostream& operator<<(std::ostream& os, const JointMove& move);
 std::ostream& operator<<(std::ostream& os, const JointGoal& move);
 
 /*****************************************************************************************
- * Fluent represents a GDL true fact.
+ * Fluent represents a GDL true fact. Like Player and Move it is a plain handle that must
+ * not outlive its Game.
  *****************************************************************************************/
 class Fluent {
 public:
-    Fluent(const Fluent& other);
-    Fluent& operator=(const Fluent& other);
-
     bool operator==(const Fluent& other) const;
     bool operator!=(const Fluent& other) const;
     bool operator<(const Fluent& other) const;
@@ -116,15 +131,145 @@ private:
     friend class State;
     friend std::ostream& operator<<(std::ostream& os, const Fluent& fluent);
 
-    boost::shared_ptr<const HSFCManager> manager_;
+    const HSFCManager* manager_;
     unsigned int hsfc_index_;
     unsigned int hsfc_ID_;
-    Fluent(boost::shared_ptr<const HSFCManager> manager, const hsfcTuple& fluent);
+    Fluent(const HSFCManager* manager, const hsfcTuple& fluent);
 };
 
 std::size_t hash_value(const Fluent& fluent); /* can be a key in boost::unordered_*  */
 std::ostream& operator<<(std::ostream& os, const Fluent& fluent);
 
+/*****************************************************************************************
+ * A joint move and a joint goal held in fixed size arrays indexed by the players' roleids.
+ * Building one never allocates, hashes a player or counts a reference, so these are the
+ * forms for search code. JointMove and JointGoal are map forms of the same thing, kept
+ * for convenience, and each form converts to the other. Like Move they refer to their
+ * Game without owning it. Only games with at most MaxPlayers players can use them.
+ *****************************************************************************************/
+class JointMoveArray
+{
+public:
+    static const unsigned int MaxPlayers = 16;
+
+    JointMoveArray();
+    explicit JointMoveArray(const JointMove& jmove);
+
+    /* The number of players of the game, or 0 before any move has been set. */
+    unsigned int size() const;
+
+    /* Whether a player has a move, and whether every player has one. */
+    bool has(unsigned int roleid) const;
+    bool complete() const;
+
+    /* The move of a player. Throws if the player has no move. */
+    Move operator[](unsigned int roleid) const;
+    Move operator[](const Player& player) const;
+
+    /* Set the move of the player that the move belongs to. */
+    void set(const Move& move);
+    void clear();
+
+    JointMove tomap() const;
+
+    bool operator==(const JointMoveArray& other) const;
+    bool operator!=(const JointMoveArray& other) const;
+    std::size_t hash_value() const;
+
+private:
+    friend class State;
+    friend class JointMoves;
+    friend std::ostream& operator<<(std::ostream& os, const JointMoveArray& jmove);
+
+    const HSFCManager* manager_;
+    unsigned int size_;
+    unsigned int set_;               // A bit for each player with a move
+    hsfcTuple moves_[MaxPlayers];
+
+    void legals(std::vector<hsfcLegalMove>& dest) const;
+};
+
+std::size_t hash_value(const JointMoveArray& jmove); /* can be a key in boost::unordered_*  */
+std::ostream& operator<<(std::ostream& os, const JointMoveArray& jmove);
+
+class JointGoalArray
+{
+public:
+    static const unsigned int MaxPlayers = JointMoveArray::MaxPlayers;
+
+    JointGoalArray();
+    explicit JointGoalArray(const JointGoal& jgoal);
+
+    /* The number of players of the game, or 0 before it has been filled. */
+    unsigned int size() const;
+
+    unsigned int operator[](unsigned int roleid) const;
+    unsigned int operator[](const Player& player) const;
+
+    JointGoal tomap() const;
+
+private:
+    friend class State;
+    friend std::ostream& operator<<(std::ostream& os, const JointGoalArray& jgoal);
+
+    const HSFCManager* manager_;
+    unsigned int size_;
+    unsigned int goals_[MaxPlayers];
+
+    void assign(const HSFCManager* manager, const std::vector<int>& vals);
+};
+
+std::ostream& operator<<(std::ostream& os, const JointGoalArray& jgoal);
+
+/*****************************************************************************************
+ * Goal statistics gathered over a batch of playouts (see State::playouts()).
+ *****************************************************************************************/
+class PlayoutStats
+{
+public:
+    PlayoutStats();
+
+    // Number of playouts and the average number of rounds each one took
+    unsigned int count() const;
+    double rounds() const;
+
+    // Average goal value and its standard deviation for a player
+    double mean(const Player& player) const;
+    double stddev(const Player& player) const;
+
+    // Fold in the results of another batch
+    void merge(const PlayoutStats& other);
+
+private:
+    friend class State;
+
+    unsigned int count_;
+    double rounds_;
+    std::vector<double> total_;
+    std::vector<double> squaretotal_;
+
+    PlayoutStats(const hsfcPlayOutStats& stats);
+    unsigned int roleid(const Player& player) const;
+};
+
+/*****************************************************************************************
+ * The result of State::playouts(): the statistics over every playout and broken down by
+ * the joint move that each playout started with. The breakdown has an entry for every
+ * joint move of the state, in the order of State::joints().
+ *****************************************************************************************/
+class PlayoutResults
+{
+public:
+    const PlayoutStats& total() const;
+    const std::vector<std::pair<JointMove, PlayoutStats> >& moves() const;
+
+private:
+    friend class State;
+
+    PlayoutStats total_;
+    std::vector<std::pair<JointMove, PlayoutStats> > moves_;
+};
+
 /*****************************************************************************************
  * A game object - only one per loaded GDL game.
  *****************************************************************************************/
@@ -189,7 +334,7 @@ void Game::players(OutputIterator dest) const
 {
     for (unsigned int i = 0; i < manager_->NumPlayers(); ++i)
     {
-        *dest++=Player(manager_, i);
+        *dest++=Player(manager_.get(), i);
     }
 }
 
@@ -202,6 +347,11 @@ class State
 public:
     State(Game& game);
     State(Game& game, const PortableState& ps);
+
+    /*
+     * Copies are cheap: they share the internal state until one of them is changed
+     * by play() or playout().
+     */
     State(const State& other);
     State& operator=(const State& other);
     ~State();
@@ -219,6 +369,21 @@ public:
     boost::unordered_map<Player, std::vector<Move> > legals() const;
     std::vector<JointMove> joints() const;
 
+    /*
+     * Return a view of the joint moves that builds each one only when it is asked
+     * for. The joint moves are in the same order as joints(). Must be called only
+     * in non-terminal states.
+     */
+    JointMoves jointMoves() const;
+
+    /*
+     * Return the legal moves of one player. Only the rules that the legal moves
+     * depend on are run, so this is cheaper than legals() when the other players'
+     * moves are not needed. Must be called only in non-terminal states.
+     */
+    template<typename OutputIterator>
+    void legals(const Player& player, OutputIterator dest) const;
+
     /*
      * Return the goals. Must be called only in terminal states.
      */
@@ -226,6 +391,13 @@ public:
     void goals(OutputIterator dest) const;
 
     JointGoal goals() const;
+    void goals(JointGoalArray& dest) const;
+
+    /*
+     * Return the goal of one player. Only the rules that the goals depend on are
+     * run. Must be called only in terminal states.
+     */
+    unsigned int goal(const Player& player) const;
 
     /*
      * Return the fluents.
@@ -243,17 +415,76 @@ public:
     template<typename OutputIterator>
     void playout(OutputIterator dest);
     JointGoal playout();
+    void playout(JointGoalArray& dest);
+
+    /*
+     * As above but the random moves are seeded first, so the same seed from the
+     * same state always gives the same playout. The seed carries on into later
+     * unseeded playouts by the same thread.
+     */
+    void playout(std::vector<PlayerGoal>& dest, unsigned int seed);
+
+    template<typename OutputIterator>
+    void playout(OutputIterator dest, unsigned int seed);
+
+    /*
+     * As above but the moves are chosen by the given policy rather than uniformly. A
+     * policy that learns (such as hsfcMASTPolicy) is updated with the result of the
+     * playout, so it must not be shared between threads.
+     */
+    void playout(std::vector<PlayerGoal>& dest, hsfcPolicy& policy);
+
+    template<typename OutputIterator>
+    void playout(OutputIterator dest, hsfcPolicy& policy);
+
+    /*
+     * As above but the moves played are also recorded. The trajectory is cleared and
+     * then gets the relationid() of each player's move for every round, with the moves
+     * of a round in player order. The buffer can be reused between playouts. With no
+     * policy the moves are chosen uniformly.
+     */
+    void playout(std::vector<PlayerGoal>& dest, std::vector<unsigned int>& trajectory,
+                 hsfcPolicy* policy=NULL);
+
+    /*
+     * Run a batch of random playouts without changing this state. The playouts
+     * are shared evenly among the joint moves of joints(), each getting the same
+     * number give or take one, and the work is spread over the given number of
+     * threads (0 means one per hardware thread). For a given number of threads
+     * the seed fixes the whole batch.
+     * Must be called only in non-terminal states.
+     */
+    PlayoutResults playouts(unsigned int count, unsigned int threads=1,
+                            unsigned int seed=0) const;
 
     /*
      * Make a move.
      *
+     * Will throw an exception if a move is not legal or there is not exactly one move
+     * per player.
      */
     void play(const JointMove& moves);
+    void play(const JointMoveArray& moves);
     void play(const std::vector<PlayerMove>& moves); // deprecated!
 
+    /*
+     * Make the joint move with the given index in jointMoves().
+     */
+    void play(std::size_t index);
+
     template<typename Iterator>
     void play(Iterator begin, Iterator end);
 
+    /*
+     * Make a move without checking it. Only for moves that were taken from the legal
+     * moves of this state (or an equal one), with exactly one move per player.
+     */
+    void playUnchecked(const JointMove& moves);
+    void playUnchecked(const JointMoveArray& moves);
+
+    template<typename Iterator>
+    void playUnchecked(Iterator begin, Iterator end);
+
 
     /****************************************************************
      * DEBUG ONLY FUNCTIONS:
@@ -264,63 +495,139 @@ public:
 
 private:
     friend class PortableState;
+    friend class UCTSearch;
+    friend class JointMoves;
 
-    hsfcState* state_;
+    /*
+     * What has been calculated from the internal state: whether it is terminal and then
+     * either the legal moves or the goals. It is calculated on first use and shared,
+     * along with the internal state, by copies of this state. The questions about one
+     * player may calculate only whether it is terminal.
+     */
+    struct Evaluation
+    {
+        Evaluation() : done(false), checked(false), terminal(false) { }
+
+        boost::mutex mutex;
+        bool done;
+        bool checked;       // terminal has been calculated
+        bool terminal;
+        std::vector<hsfcLegalMove> legals;
+        std::vector<int> goals;
+
+        // The legal moves of each player in turn: those of player i are
+        // legals[byrole[k]] for offsets[i] <= k < offsets[i+1]
+        std::vector<unsigned int> byrole;
+        std::vector<unsigned int> offsets;
+    };
+
+    // Shared by copies of this state until one of them is changed
+    boost::shared_ptr<hsfcState> state_;
+    boost::shared_ptr<Evaluation> eval_;
     boost::shared_ptr<HSFCManager> manager_;
 
     friend std::ostream& operator<<(std::ostream& os, const State& state);
 
-    void initialize();
+    const Evaluation& evaluate() const;
 
-    /*
-     * Internal format to return the legals in a structure that is easy
-     * to check if some move is legal.
-     */
-    void get_legals(boost::unordered_map<Player, boost::unordered_set<Move> >& lgls) const;
-    void throw_on_illegal_move(const PlayerMove& pm,
-                               boost::unordered_map<Player, boost::unordered_set<Move> >& legals) const;
+    // The legal moves or the goal of one player. Unless the state has already been
+    // evaluated only the rules that they depend on are run.
+    void evaluate_legals(unsigned int roleid, std::vector<hsfcLegalMove>& dest) const;
+    unsigned int evaluate_goal(unsigned int roleid) const;
+
+    // Take a private copy of the internal state before changing it
+    void detach();
+
+    // The internal state has been changed so nothing calculated from it is valid
+    void changed();
+
+    // Check a move against the legal relation of the state
+    void throw_on_illegal_move(const PlayerMove& pm) const;
+
+    // Check the state and the goal values after a playout
+    void check_playout(const std::vector<int>& vals) const;
+
+    // As above and then return the goals
+    template<typename OutputIterator>
+    void playout_goals(const std::vector<int>& vals, OutputIterator dest);
 };
 
 std::ostream& operator<<(std::ostream& os, const State& state);
 
+/*****************************************************************************************
+ * The joint moves of a non-terminal state, without building them all. Each joint move has
+ * an index below size(): a mixed-radix number with a digit for each player, in player
+ * order, that picks one of the player's legal moves (the last player's digit changes
+ * fastest). The view shares the legal moves of the state, so it stays valid when the
+ * state is changed. Like Move it refers to its Game without owning it.
+ *****************************************************************************************/
+class JointMoves
+{
+public:
+    std::size_t size() const;
+
+    /* The number of legal moves of a player, which is the radix of its digit. */
+    std::size_t numMoves(const Player& player) const;
+
+    JointMove operator[](std::size_t index) const;
+    void get(std::size_t index, JointMoveArray& dest) const;
+
+    /* The moves of the joint move with the given index, in player order. */
+    template<typename OutputIterator>
+    void moves(std::size_t index, OutputIterator dest) const;
+
+private:
+    friend class State;
+
+    const HSFCManager* manager_;
+    boost::shared_ptr<const State::Evaluation> eval_;
+    std::size_t size_;
+
+    JointMoves(const HSFCManager* manager, boost::shared_ptr<const State::Evaluation> eval);
+
+    // The legal move of the player picked by its digit of the index
+    const hsfcLegalMove& legal(std::size_t index, unsigned int roleid) const;
+    void legals(std::size_t index, std::vector<hsfcLegalMove>& dest) const;
+};
+
 
 template<typename OutputIterator>
 void State::legals(OutputIterator dest) const
 {
-    boost::unordered_set<int> ok;
-    std::vector<hsfcLegalMove> lms;
-    if (this->isTerminal())
+    const Evaluation& eval = evaluate();
+    if (eval.terminal)
         throw HSFCValueError() << ErrorMsgInfo("Cannot cal legals() on a terminal state");
 
-    manager_->GetLegalMoves(*state_, lms);
-    BOOST_FOREACH( hsfcLegalMove& lm, lms)
+    BOOST_FOREACH(const hsfcLegalMove& lm, eval.legals)
     {
-        *dest++=PlayerMove(Player(manager_, lm.RoleIndex), Move(manager_, lm));
-        ok.insert(lm.RoleIndex);
+        *dest++=PlayerMove(Player(manager_.get(), lm.RoleIndex), Move(manager_.get(), lm));
     }
-    if (ok.size() != manager_->NumPlayers())
+}
+
+template<typename OutputIterator>
+void State::legals(const Player& player, OutputIterator dest) const
+{
+    std::vector<hsfcLegalMove> lms;
+    if (player.manager_ != manager_.get())
+        throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+    evaluate_legals(player.roleid_, lms);
+
+    BOOST_FOREACH(const hsfcLegalMove& lm, lms)
     {
-        throw HSFCInternalError()
-            << ErrorMsgInfo("HSFC internal error: missing moves for some players");
+        *dest++=Move(manager_.get(), lm);
     }
 }
 
 template<typename OutputIterator>
 void State::goals(OutputIterator dest) const
 {
-    std::vector<int> vals;
-    if (!(this->isTerminal()))
+    const Evaluation& eval = evaluate();
+    if (!eval.terminal)
         throw HSFCValueError() << ErrorMsgInfo("Cannot call goals() on a non-terminal state");
-    manager_->GetGoalValues(*state_, vals);
-    if (vals.size() != manager_->NumPlayers())
-    {
-        throw HSFCInternalError()
-            << ErrorMsgInfo("HSFC internal error: no goal value for some players");
-    }
 
-    for (unsigned int i = 0; i < vals.size(); ++i)
+    for (unsigned int i = 0; i < eval.goals.size(); ++i)
     {
-        *dest++=PlayerGoal(Player(manager_, i), (unsigned int)vals[i]);
+        *dest++=PlayerGoal(Player(manager_.get(), i), (unsigned int)eval.goals[i]);
     }
 }
 
@@ -329,7 +636,7 @@ void State::fluents(OutputIterator dest) const {
     std::vector<hsfcTuple> vals;
     manager_->GetFluents(*state_, vals);
     for (unsigned int i = 0; i < vals.size(); ++i) {
-        *dest++=Fluent(manager_, vals[i]);
+        *dest++=Fluent(manager_.get(), vals[i]);
     }
 }
 
@@ -339,52 +646,94 @@ void State::playout(OutputIterator dest)
     std::vector<int> vals;
     if (this->isTerminal())
         throw HSFCValueError() << ErrorMsgInfo("Cannot playout() on a terminal state");
+    detach();
     manager_->PlayOut(*state_, vals);
-    if (vals.size() != manager_->NumPlayers())
-    {
-        throw HSFCInternalError()
-            << ErrorMsgInfo("HSFC internal error: no goal value for some players");
-    }
+    changed();
+    this->playout_goals(vals, dest);
+}
 
-    // Not sure if this is necessary, but added a test for termination
-    // because it turns out that checking for termination does change
-    // some internal structures in the state.
-    if (!this->isTerminal())
-        throw HSFCInternalError() << ErrorMsgInfo("State is not terminal after a playout()");
+template<typename OutputIterator>
+void State::playout(OutputIterator dest, hsfcPolicy& policy)
+{
+    std::vector<int> vals;
+    if (this->isTerminal())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot playout() on a terminal state");
+    detach();
+    manager_->PlayOut(*state_, vals, policy);
+    changed();
+    this->playout_goals(vals, dest);
+}
 
+template<typename OutputIterator>
+void State::playout_goals(const std::vector<int>& vals, OutputIterator dest)
+{
+    this->check_playout(vals);
     for (unsigned int i = 0; i < vals.size(); ++i)
     {
-        *dest++= PlayerGoal(Player(manager_,i), (unsigned int)vals[i]);
+        *dest++= PlayerGoal(Player(manager_.get(), i), (unsigned int)vals[i]);
     }
 }
 
+template<typename OutputIterator>
+void State::playout(OutputIterator dest, unsigned int seed)
+{
+    manager_->SeedRandom(seed);
+    this->playout(dest);
+}
+
 template<typename Iterator>
 void State::play(Iterator begin, Iterator end)
 {
-    boost::unordered_set<int> ok;
+    std::vector<bool> ok(manager_->NumPlayers(), false);
     std::vector<hsfcLegalMove> lms;
 
-    boost::unordered_map<Player, boost::unordered_set<Move> > lglmap;
-    get_legals(lglmap);
     if (this->isTerminal())
         throw HSFCValueError() << ErrorMsgInfo("Cannot play() on a terminal state");
     while (begin != end)
     {
-        throw_on_illegal_move(*begin, lglmap);
+        throw_on_illegal_move(*begin);
         if (begin->first.roleid_ != begin->second.move_.RoleIndex)
             throw HSFCValueError() << ErrorMsgInfo("Mismatched Player and Move");
+        if (ok[begin->first.roleid_])
+            throw HSFCValueError() << ErrorMsgInfo("Must be exactly one move per player");
         lms.push_back(begin->second.move_);
-        ok.insert(begin->first.roleid_);
+        ok[begin->first.roleid_] = true;
         ++begin;
     }
-    if (ok.size() != manager_->NumPlayers())
+    if (lms.size() != manager_->NumPlayers())
         throw HSFCValueError() << ErrorMsgInfo("Must be exactly one move per player");
+    detach();
     manager_->DoMove(*state_, lms);
+    changed();
+}
 
-    initialize();
+template<typename Iterator>
+void State::playUnchecked(Iterator begin, Iterator end)
+{
+    std::vector<hsfcLegalMove> lms;
+    lms.reserve(manager_->NumPlayers());
+    while (begin != end)
+    {
+        lms.push_back(begin->second.move_);
+        ++begin;
+    }
+    detach();
+    manager_->AdvanceToLegals(*state_);
+    manager_->DoMove(*state_, lms);
+    changed();
 }
 
 
+template<typename OutputIterator>
+void JointMoves::moves(std::size_t index, OutputIterator dest) const
+{
+    if (index >= size_)
+        throw HSFCValueError() << ErrorMsgInfo("Joint move index out of range");
+    for (unsigned int r = 0; r < manager_->NumPlayers(); ++r)
+    {
+        *dest++=PlayerMove(Player(manager_, r), Move(manager_, legal(index, r)));
+    }
+}
 
 
 }; /* namespace HSFC */
@@ -17,6 +17,9 @@ class State;
 class Move;
 class Player;
 class Fluent;
+class JointMoves;
+class JointMoveArray;
+class JointGoalArray;
 
 typedef std::pair<Player, Move> PlayerMove;
 typedef std::pair<Player, unsigned int> PlayerGoal;
@@ -12,7 +12,11 @@
 #include <vector>
 #include <map>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <hsfc/impl/hsfcEngine.h>
 
@@ -41,8 +45,34 @@ private:
 
     boost::scoped_ptr<hsfcGDLParameters> params_;
 
+    // Recycled game states and the engine context used to advance them.
+    // Each thread keeps its own free list and context so that threads can
+    // work on different states of the one game without locking. They are
+    // registered here so that the manager can free them at the end, and
+    // the data of a thread that has exited is handed on to the next new
+    // thread rather than piling up.
+    struct ThreadData
+    {
+        std::vector<hsfcState*> pool;
+        hsfcContext* context;
+    };
+    unsigned long poolid_;
+    mutable boost::mutex poolmutex_;
+    mutable std::vector<boost::shared_ptr<ThreadData> > threaddata_;
+    ThreadData& LocalData() const;
+    hsfcContext* LocalContext() const;
+
+    // The printed text of each move and fluent that has been printed, by its
+    // relation index and ID. Entries are only ever added, so a reference to
+    // the text stays valid for the life of the manager.
+    typedef std::pair<unsigned int, unsigned int> TextKey;
+    mutable boost::shared_mutex textmutex_;
+    mutable boost::unordered_map<TextKey, std::string> text_;
+    const std::string& RelationText(const hsfcTuple& tuple, bool action) const;
+
 public:
     HSFCManager();
+    ~HSFCManager();
 
     /* Functions from hsfcGDLManager with const fixes */
     hsfcState* CreateGameState();
@@ -51,15 +81,35 @@ public:
     void SetInitialGameState(hsfcState& GameState);
     void GetLegalMoves(const hsfcState& GameState,
                        std::vector<hsfcLegalMove>& LegalMove) const;
+    void GetLegalMoves(const hsfcState& GameState, unsigned int RoleIndex,
+                       std::vector<hsfcLegalMove>& LegalMove) const;
+    bool IsLegalMove(const hsfcState& GameState, const hsfcLegalMove& LegalMove) const;
     void DoMove(hsfcState& GameState, const std::vector<hsfcLegalMove>& LegalMove);
+    /* Bring a state to the step DoMove requires without listing the legal moves. */
+    void AdvanceToLegals(hsfcState& GameState) const;
     bool IsTerminal(const hsfcState& GameState) const;
     void GetGoalValues(const hsfcState& GameState, std::vector<int>& GoalValue) const;
+    int GetGoalValue(const hsfcState& GameState, unsigned int RoleIndex) const;
     void PlayOut(hsfcState& GameState, std::vector<int>& GoalValue);
+    void PlayOut(hsfcState& GameState, std::vector<int>& GoalValue, unsigned int Seed);
+    void PlayOut(hsfcState& GameState, std::vector<int>& GoalValue, hsfcPolicy& Policy);
+    void PlayOut(hsfcState& GameState, std::vector<int>& GoalValue, hsfcPolicy* Policy,
+                 std::vector<unsigned int>& Trajectory);
+    void PlayOuts(const hsfcState& GameState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats);
+
+    /* Seed the random moves of the calling thread's playouts. */
+    void SeedRandom(unsigned int Seed);
+
+    /* Pooled states - already initialised states are handed out and taken back
+       rather than being created and freed each time. */
+    hsfcState* AcquireGameState();
+    void ReleaseGameState(hsfcState* GameState);
 
     /* Additional functions - note: capitalised first letters for class consistency. */
     unsigned int NumPlayers() const;
     std::ostream& PrintPlayer(std::ostream& os, unsigned int roleid) const;
     std::ostream& PrintMove(std::ostream& os, const hsfcLegalMove& legalmove) const;
+    const std::string& MoveText(const hsfcLegalMove& legalmove) const;
 
     // These are debugging functions. Don't use them except for debugging code.
     std::ostream& PrintState(std::ostream& os, const hsfcState& GameState) const;
@@ -85,6 +135,8 @@ public:
     void SetStateData(const std::set<std::pair<int,int> >& relationset, int round,
                       int currentstep, hsfcState& state);
 
+    std::ostream& PrintFluent(std::ostream& os, const hsfcTuple& fluent) const;
+    const std::string& FluentText(const hsfcTuple& fluent) const;
     void PrintFluent(const hsfcTuple& fluent, std::string& text) const;
     void GetFluents(const hsfcState& state, std::vector<hsfcTuple>& fluents) const;
 };
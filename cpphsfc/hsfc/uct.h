@@ -0,0 +1,89 @@
+/*****************************************************************************************
+ *
+ * UCT Search.
+ * A Monte Carlo tree search over the game states of a Game. Rather than going through
+ * joints(), play() and playout() for every step of every iteration it works directly on
+ * the internal game states, so the tree only needs to hold the legal moves and the move
+ * statistics of each node.
+ *
+ * - Simultaneous moves are handled by decoupled UCT: at each node every player picks
+ *   its own move by UCB1 over its own move statistics and together these make up the
+ *   joint move that is followed.
+ *
+ * - The tree is shared by all the worker threads. Each node has its own lock and a
+ *   virtual loss is added to a move on the way down (a visit with no reward yet) so
+ *   that threads are steered away from each other's paths.
+ *
+ * - The tree can be reused between plies: play() moves the root on to the joint move
+ *   that was actually played and keeps the subtree under it.
+ *
+ * Goal values are kept in their GDL range (0-100) but are scaled to 0-1 for UCB1, so
+ * the exploration constant is on the usual scale.
+ *
+ *****************************************************************************************/
+#ifndef HSFC_UCT_H
+#define HSFC_UCT_H
+
+#include <vector>
+#include <boost/utility.hpp>
+#include <hsfc/hsfc.h>
+
+namespace HSFC
+{
+
+class UCTSearch : private boost::noncopyable
+{
+public:
+    UCTSearch(const State& root, unsigned int threads=1, double exploration=1.0,
+              unsigned int seed=0);
+    ~UCTSearch();
+
+    /*
+     * Grow the tree for the given number of iterations or until the given number of
+     * seconds has passed, whichever comes first. Zero means no limit of that kind, but
+     * there must be at least one limit. Must not be called on a terminal root.
+     */
+    void search(unsigned int iterations, double seconds=0);
+
+    /*
+     * The most visited move for a player (or every player) at the root. There must
+     * have been at least one iteration through the root.
+     */
+    Move best(const Player& player) const;
+    JointMove best() const;
+
+    // The visits to and the average goal value of a player's move at the root.
+    unsigned int visits(const Player& player, const Move& move) const;
+    double value(const Player& player, const Move& move) const;
+
+    /*
+     * Move the root on by the joint move that was actually played. The subtree under
+     * that joint move is kept and the rest of the tree is thrown away.
+     */
+    void play(const JointMove& move);
+
+    const State& root() const;
+
+    // Iterations through the current root and the number of nodes in the tree.
+    unsigned int iterations() const;
+    std::size_t size() const;
+
+private:
+    struct Node;
+    struct Worker;
+
+    State root_;
+    Node* rootnode_;
+    unsigned int threads_;
+    double exploration_;
+    unsigned int seed_;
+    unsigned int searches_;
+
+    Node* newroot() const;
+    const Node& expandedroot() const;
+    unsigned int choice(const Node& node, const Player& player, const Move& move) const;
+};
+
+}; /* namespace HSFC */
+
+#endif /* HSFC_UCT_H */
@@ -2,10 +2,13 @@
 #include <sstream>
 #include <cstring>
 #include <cassert>
+#include <cmath>
 #include <map>
+#include <limits>
 #include <boost/assert.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
 #include <hsfc/hsfc.h>
 #include <hsfc/portable.h>
 #include "sexprtoflat.h"
@@ -27,15 +30,12 @@ char const* HSFCException::what() const throw ()
 /*****************************************************************************************
  * Implementation of Player
  *****************************************************************************************/
-Player::Player(boost::shared_ptr<const HSFCManager> manager, unsigned int roleid):
+Player::Player(const HSFCManager* manager, unsigned int roleid):
     manager_(manager), roleid_(roleid)
 { }
 
-Player::Player(const Player& other): manager_(other.manager_), roleid_(other.roleid_)
-{ }
-
 Player::Player(Game& game, const PortablePlayer& pp) :
-    manager_(game.manager_), roleid_(pp.roleid_)
+    manager_(game.manager_.get()), roleid_(pp.roleid_)
 {
     // Check that it is a valid roleid
     if (pp.roleid_ >= manager_->NumPlayers())
@@ -77,20 +77,13 @@ bool Player::operator>(const Player& other) const
     return roleid_ > other.roleid_;
 }
 
-Player& Player::operator=(const Player& other)
-{
-    this->manager_ = other.manager_;
-    this->roleid_ = other.roleid_;
-    return *this;
-}
-
 std::size_t Player::hash_value() const
 {
     // Note: since there is only 1 manager per game
     // we can use the pointer as a hash value.
     size_t seed = 0;
     boost::hash_combine(seed, roleid_);
-    boost::hash_combine(seed, manager_.get());
+    boost::hash_combine(seed, manager_);
     return seed;
 }
 
@@ -111,26 +104,13 @@ std::ostream& operator<<(std::ostream& os, const Player& player)
  * Implementation of Move
  *********************************************************************************/
 
-Move::Move(boost::shared_ptr<HSFCManager> manager, const hsfcLegalMove& move):
+Move::Move(const HSFCManager* manager, const hsfcLegalMove& move):
     manager_(manager), move_(move)
 {
-    if (move.Text != NULL)
-    {
-        move_.Text = new char[strlen(move.Text)+1];
-        strcpy(move_.Text, move.Text);
-    }
-}
-
-Move::Move(const Move& other): manager_(other.manager_), move_(other.move_)
-{
-    if (other.move_.Text != NULL)
-    {
-        move_.Text = new char[strlen(other.move_.Text)+1];
-        strcpy(move_.Text, other.move_.Text);
-    }
+    move_.Text = NULL;
 }
 
-Move::Move(Game& game, const PortableMove& pm) : manager_(game.manager_)
+Move::Move(Game& game, const PortableMove& pm) : manager_(game.manager_.get())
 {
     // Some validity checks of the PortableMove object
     if (pm.RoleIndex_ < 0 || pm.RelationIndex_ < 0 || pm.ID_ < 0)
@@ -140,20 +120,12 @@ Move::Move(Game& game, const PortableMove& pm) : manager_(game.manager_)
     move_.Tuple.Index = pm.RelationIndex_;
     move_.Tuple.ID = pm.ID_;
     move_.RoleIndex = pm.RoleIndex_;
-
     move_.Text = NULL;
-    if (!pm.Text_.empty())
-    {
-        move_.Text = new char[strlen(pm.Text_.c_str())+1];
-        strcpy(move_.Text, pm.Text_.c_str());
-    }
 }
 
 std::string Move::tostring() const
 {
-    std::ostringstream ss;
-    ss << *this;
-    return ss.str();
+    return manager_->MoveText(move_);
 }
 
 bool operator==(const hsfcLegalMove& a, const hsfcLegalMove& b)
@@ -180,33 +152,18 @@ bool Move::operator!=(const Move& other) const
     return !(*this == other);
 }
 
-Move& Move::operator=(const Move& other)
-{
-    manager_ = other.manager_;
-    if (move_.Text != NULL) delete[] move_.Text;
-    move_ = other.move_;
-    if (other.move_.Text != NULL)
-    {
-        move_.Text = new char[strlen(other.move_.Text)+1];
-        strcpy(move_.Text, other.move_.Text);
-    }
-
-    return *this;
-}
-
-Move::~Move()
+unsigned int Move::relationid() const
 {
-    if (move_.Text != NULL) delete[] move_.Text;
+    return move_.Tuple.ID;
 }
 
 std::size_t Move::hash_value() const
 {
     // Note: 1) since there is only 1 manager per game we can use the manager_
     //          pointer as a hash value.
-    //       2) I think the move_.Text can be generated from the other data so
-    //          we don't need to hash it. Maybe need to confirm this with Michael.
+    //       2) the text is generated from the other data so it isn't hashed.
     size_t seed = 0;
-    boost::hash_combine(seed, manager_.get());
+    boost::hash_combine(seed, manager_);
     boost::hash_combine(seed, move_.RoleIndex);
     boost::hash_combine(seed, move_.Tuple.ID);
     boost::hash_combine(seed, move_.Tuple.Index);
@@ -264,18 +221,231 @@ std::ostream& operator<<(std::ostream& os, const JointGoal& jgoal)
 
 
 /*****************************************************************************************
- * Implementation of Fluent
+ * Implementation of JointMoveArray and JointGoalArray
  *****************************************************************************************/
-Fluent::Fluent(const Fluent& other): manager_(other.manager_), hsfc_index_(other.hsfc_index_), hsfc_ID_(other.hsfc_ID_) {
+
+JointMoveArray::JointMoveArray() : manager_(NULL), size_(0), set_(0)
+{ }
+
+JointMoveArray::JointMoveArray(const JointMove& jmove) : manager_(NULL), size_(0), set_(0)
+{
+    BOOST_FOREACH(const JointMove::value_type& pm, jmove)
+    {
+        if (pm.first.manager_ != pm.second.manager_ ||
+            pm.first.roleid_ != (unsigned int)pm.second.move_.RoleIndex)
+            throw HSFCValueError() << ErrorMsgInfo("Mismatched Player and Move");
+        this->set(pm.second);
+    }
 }
 
-Fluent& Fluent::operator=(const Fluent& other) {
-    manager_ = other.manager_;
-    hsfc_index_ = other.hsfc_index_;
-    hsfc_ID_ = other.hsfc_ID_;
-    return *this;
+unsigned int JointMoveArray::size() const
+{
+    return size_;
+}
+
+bool JointMoveArray::has(unsigned int roleid) const
+{
+    return roleid < size_ && (set_ & (1u << roleid)) != 0;
+}
+
+bool JointMoveArray::complete() const
+{
+    return size_ > 0 && set_ == (1u << size_) - 1;
+}
+
+Move JointMoveArray::operator[](unsigned int roleid) const
+{
+    hsfcLegalMove lm;
+    if (!this->has(roleid))
+        throw HSFCValueError() << ErrorMsgInfo("No move for the player");
+    lm.RoleIndex = (int)roleid;
+    lm.Text = NULL;
+    lm.Tuple = moves_[roleid];
+    return Move(manager_, lm);
+}
+
+Move JointMoveArray::operator[](const Player& player) const
+{
+    if (player.manager_ != manager_)
+        throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+    return (*this)[player.roleid_];
+}
+
+void JointMoveArray::set(const Move& move)
+{
+    unsigned int roleid = (unsigned int)move.move_.RoleIndex;
+    if (manager_ == NULL)
+    {
+        if (move.manager_->NumPlayers() > MaxPlayers)
+            throw HSFCValueError() << ErrorMsgInfo("Too many players for a JointMoveArray");
+        manager_ = move.manager_;
+        size_ = manager_->NumPlayers();
+    }
+    else if (move.manager_ != manager_)
+    {
+        throw HSFCValueError() << ErrorMsgInfo("Move is from a different game");
+    }
+    if (roleid >= size_)
+        throw HSFCValueError() << ErrorMsgInfo("Move of an unknown player");
+    moves_[roleid] = move.move_.Tuple;
+    set_ |= 1u << roleid;
+}
+
+void JointMoveArray::clear()
+{
+    set_ = 0;
+}
+
+JointMove JointMoveArray::tomap() const
+{
+    JointMove result;
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        if (this->has(r)) result.emplace(Player(manager_, r), (*this)[r]);
+    }
+    return result;
+}
+
+bool JointMoveArray::operator==(const JointMoveArray& other) const
+{
+    if (manager_ != other.manager_ || set_ != other.set_) return false;
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        if (this->has(r) && (moves_[r].Index != other.moves_[r].Index ||
+                             moves_[r].ID != other.moves_[r].ID)) return false;
+    }
+    return true;
+}
+
+bool JointMoveArray::operator!=(const JointMoveArray& other) const
+{
+    return !(*this == other);
+}
+
+std::size_t JointMoveArray::hash_value() const
+{
+    size_t seed = 0;
+    boost::hash_combine(seed, manager_);
+    boost::hash_combine(seed, set_);
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        if (!this->has(r)) continue;
+        boost::hash_combine(seed, moves_[r].ID);
+        boost::hash_combine(seed, moves_[r].Index);
+    }
+    return seed;
+}
+
+void JointMoveArray::legals(std::vector<hsfcLegalMove>& dest) const
+{
+    dest.resize(size_);
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        dest[r].RoleIndex = (int)r;
+        dest[r].Text = NULL;
+        dest[r].Tuple = moves_[r];
+    }
+}
+
+std::size_t hash_value(const JointMoveArray& jmove)
+{
+    return jmove.hash_value();
+}
+
+std::ostream& operator<<(std::ostream& os, const JointMoveArray& jmove)
+{
+    for (unsigned int r = 0; r < jmove.size_; ++r)
+    {
+        if (!jmove.has(r)) continue;
+        os << "(does ";
+        jmove.manager_->PrintPlayer(os, r);
+        os << " " << jmove[r] << ") ";
+    }
+    return os;
+}
+
+JointGoalArray::JointGoalArray() : manager_(NULL), size_(0)
+{ }
+
+JointGoalArray::JointGoalArray(const JointGoal& jgoal) : manager_(NULL), size_(0)
+{
+    unsigned int found = 0;
+    BOOST_FOREACH(const JointGoal::value_type& pg, jgoal)
+    {
+        if (manager_ == NULL)
+        {
+            if (pg.first.manager_->NumPlayers() > MaxPlayers)
+                throw HSFCValueError() << ErrorMsgInfo("Too many players for a JointGoalArray");
+            manager_ = pg.first.manager_;
+            size_ = manager_->NumPlayers();
+        }
+        else if (pg.first.manager_ != manager_)
+        {
+            throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+        }
+        goals_[pg.first.roleid_] = pg.second;
+        found |= 1u << pg.first.roleid_;
+    }
+    if (size_ > 0 && found != (1u << size_) - 1)
+        throw HSFCValueError() << ErrorMsgInfo("Must be exactly one goal per player");
+}
+
+unsigned int JointGoalArray::size() const
+{
+    return size_;
+}
+
+unsigned int JointGoalArray::operator[](unsigned int roleid) const
+{
+    if (roleid >= size_)
+        throw HSFCValueError() << ErrorMsgInfo("No goal for the player");
+    return goals_[roleid];
+}
+
+unsigned int JointGoalArray::operator[](const Player& player) const
+{
+    if (player.manager_ != manager_)
+        throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+    return (*this)[player.roleid_];
+}
+
+JointGoal JointGoalArray::tomap() const
+{
+    JointGoal result;
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        result.emplace(Player(manager_, r), goals_[r]);
+    }
+    return result;
+}
+
+void JointGoalArray::assign(const HSFCManager* manager, const std::vector<int>& vals)
+{
+    if (vals.size() > MaxPlayers)
+        throw HSFCValueError() << ErrorMsgInfo("Too many players for a JointGoalArray");
+    manager_ = manager;
+    size_ = vals.size();
+    for (unsigned int r = 0; r < size_; ++r)
+    {
+        goals_[r] = (unsigned int)vals[r];
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const JointGoalArray& jgoal)
+{
+    for (unsigned int r = 0; r < jgoal.size_; ++r)
+    {
+        os << "(goal ";
+        jgoal.manager_->PrintPlayer(os, r);
+        os << " " << jgoal.goals_[r] << ") ";
+    }
+    return os;
 }
 
+
+/*****************************************************************************************
+ * Implementation of Fluent
+ *****************************************************************************************/
 bool Fluent::operator==(const Fluent& other) const {
     BOOST_ASSERT_MSG(manager_ == other.manager_, "Fluent object created with different Game() instances");
     return hsfc_index_ == other.hsfc_index_ && hsfc_ID_ == other.hsfc_ID_;
@@ -295,20 +465,21 @@ bool Fluent::operator>(const Fluent& other) const {
 }
 
 std::string Fluent::tostring() const {
-    std::ostringstream ss;
-    ss << *this;
-    return ss.str();
+    hsfcTuple tmp;
+    tmp.Index = hsfc_index_;
+    tmp.ID = hsfc_ID_;
+    return manager_->FluentText(tmp);
 }
 
 std::size_t Fluent::hash_value() const {
     size_t seed = 0;
-    boost::hash_combine(seed, manager_.get());
+    boost::hash_combine(seed, manager_);
     boost::hash_combine(seed, hsfc_index_);
     boost::hash_combine(seed, hsfc_ID_);
     return seed;
 }
 
-Fluent::Fluent(boost::shared_ptr<const HSFCManager> manager, const hsfcTuple& fluent): manager_(manager), hsfc_index_(fluent.Index), hsfc_ID_(fluent.ID) {
+Fluent::Fluent(const HSFCManager* manager, const hsfcTuple& fluent): manager_(manager), hsfc_index_(fluent.Index), hsfc_ID_(fluent.ID) {
 }
 
 std::size_t hash_value(const Fluent& fluent) {
@@ -319,11 +490,83 @@ std::ostream& operator<<(std::ostream& os, const Fluent& fluent) {
     hsfcTuple tmp;
     tmp.Index = fluent.hsfc_index_;
     tmp.ID = fluent.hsfc_ID_;
-    std::string st;
-    fluent.manager_->PrintFluent(tmp, st);
-    return os << st;
+    return fluent.manager_->PrintFluent(os, tmp);
+}
+
+
+/*****************************************************************************************
+ * Implementation of PlayoutStats and PlayoutResults
+ *****************************************************************************************/
+PlayoutStats::PlayoutStats() : count_(0), rounds_(0)
+{ }
+
+PlayoutStats::PlayoutStats(const hsfcPlayOutStats& stats) :
+    count_(stats.NumPlayOuts), rounds_(stats.NumRounds),
+    total_(stats.GoalTotal), squaretotal_(stats.GoalSquareTotal)
+{ }
+
+unsigned int PlayoutStats::count() const
+{
+    return count_;
+}
+
+double PlayoutStats::rounds() const
+{
+    if (count_ == 0) return 0;
+    return rounds_ / count_;
+}
+
+unsigned int PlayoutStats::roleid(const Player& player) const
+{
+    if (player.roleid_ >= total_.size())
+        throw HSFCValueError() << ErrorMsgInfo("No playout statistics for player");
+    return player.roleid_;
+}
+
+double PlayoutStats::mean(const Player& player) const
+{
+    if (count_ == 0) return 0;
+    return total_[roleid(player)] / count_;
+}
+
+double PlayoutStats::stddev(const Player& player) const
+{
+    if (count_ == 0) return 0;
+    unsigned int i = roleid(player);
+    double m = total_[i] / count_;
+    double variance = squaretotal_[i] / count_ - m * m;
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+void PlayoutStats::merge(const PlayoutStats& other)
+{
+    if (other.count_ == 0) return;
+    if (total_.empty())
+    {
+        total_.assign(other.total_.size(), 0);
+        squaretotal_.assign(other.squaretotal_.size(), 0);
+    }
+    if (total_.size() != other.total_.size())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot merge playout statistics of different games");
+
+    count_ += other.count_;
+    rounds_ += other.rounds_;
+    for (unsigned int i = 0; i < total_.size(); ++i)
+    {
+        total_[i] += other.total_[i];
+        squaretotal_[i] += other.squaretotal_[i];
+    }
 }
 
+const PlayoutStats& PlayoutResults::total() const
+{
+    return total_;
+}
+
+const std::vector<std::pair<JointMove, PlayoutStats> >& PlayoutResults::moves() const
+{
+    return moves_;
+}
 
 /*****************************************************************************************
  * Implementation of Game
@@ -449,85 +692,184 @@ void validate(const std::string& gdldescription)
  * Implementation of State
  * NOTE: 20140612. From what I can tell from looking at the HSFC code a state isn't
  * in some sense valid until it has had the legal moves calculated from it. Or at least
- * you cannot run Play() from a state that has not had legal moves calculated. So as
- * a hack I will calculate (and throw away) the legal moves whenever I create a state and
- * whenever I run Play().
+ * you cannot run Play() from a state that has not had legal moves calculated.
+ *
+ * The legal moves (or the goals of a terminal state) are now calculated the first time
+ * anything asks for them and are kept until the state changes. Copies share the internal
+ * state and its evaluation until one of them is changed by play() or playout(). Only
+ * then does that copy take a private internal state.
  *****************************************************************************************/
-void State::initialize(){
+namespace
+{
+// Hands an internal state back to the pool when the last State sharing it goes
+struct ReleaseGameState
+{
+    boost::shared_ptr<HSFCManager> manager;
 
-    // Hack to calculate legal moves so that the state will now be in a good "state".
-    if (!isTerminal()) {
-        std::vector<PlayerMove> legalMoves;
-        legals(std::back_inserter(legalMoves));
-    } else {
-        goals();
+    void operator()(hsfcState* state) const
+    {
+        manager->ReleaseGameState(state);
     }
+};
+
+boost::shared_ptr<hsfcState> acquire_state(const boost::shared_ptr<HSFCManager>& manager)
+{
+    ReleaseGameState release;
+    release.manager = manager;
+    return boost::shared_ptr<hsfcState>(manager->AcquireGameState(), release);
+}
 }
 
-State::State(Game& game): manager_(game.manager_), state_(NULL)
+State::State(Game& game): eval_(boost::make_shared<Evaluation>()), manager_(game.manager_)
 {
-    state_ = manager_->CreateGameState();
+    state_ = acquire_state(manager_);
     manager_->SetInitialGameState(*state_);
-    this->initialize();
 }
 
-State::State(Game& game, const PortableState& ps): manager_(game.manager_), state_(NULL)
+State::State(Game& game, const PortableState& ps):
+    eval_(boost::make_shared<Evaluation>()), manager_(game.manager_)
 {
     if (ps.relationset_.empty())
         throw HSFCValueError() <<
             ErrorMsgInfo("Cannot create a State from an empty PortableState");
 
-    state_ = manager_->CreateGameState();
+    state_ = acquire_state(manager_);
     manager_->SetInitialGameState(*state_);
-    this->initialize();
 
 /*
     std::vector<std::pair<int,int> > relationlist(ps.relationset_.begin(), ps.relationset_.end());
     manager_->SetStateData(relationlist, ps.round_, ps.currentstep_, *state_);
 */
     manager_->SetStateData(ps.relationset_, ps.round_, ps.currentstep_, *state_);
-    this->initialize();
 }
 
 
-State::State(const State& other) : manager_(other.manager_), state_(NULL)
-{
-    state_ = manager_->CreateGameState();
-    manager_->SetInitialGameState(*state_);
-    manager_->CopyGameState(*state_, *(other.state_));
-    this->initialize();
-}
+State::State(const State& other) :
+    state_(other.state_), eval_(other.eval_), manager_(other.manager_)
+{ }
 
 State& State::operator=(const State& other)
 {
     if (manager_ != other.manager_)
         throw HSFCValueError() << ErrorMsgInfo("Cannot assign to a State from a different game");
-    manager_->SetInitialGameState(*state_);
-    manager_->CopyGameState(*state_, *(other.state_));
-    this->initialize();
+    state_ = other.state_;
+    eval_ = other.eval_;
 
     return *this;
 }
 
 State::~State()
+{ }
+
+const State::Evaluation& State::evaluate() const
 {
-    if (state_ != NULL)
-    {
-        manager_->FreeGameState(state_);
+    // Copies in other threads may be evaluating the same internal state
+    boost::mutex::scoped_lock lock(eval_->mutex);
+    if (eval_->done) return *eval_;
 
-        // Note: I don't know if it was intended that FreeGameState()
-        // delete's the state_ object itself rather than just internal
-        // pointers. In any case handling it here so I avoid modifying
-        // the libhsfc code.
+    if (!eval_->checked) eval_->terminal = manager_->IsTerminal(*state_);
+    eval_->checked = true;
+    if (eval_->terminal)
+    {
+        manager_->GetGoalValues(*state_, eval_->goals);
+        if (eval_->goals.size() != manager_->NumPlayers())
+        {
+            throw HSFCInternalError()
+                << ErrorMsgInfo("HSFC internal error: no goal value for some players");
+        }
+    }
+    else
+    {
+        // Index the legal moves by player, which also finds any missing players
+        unsigned int numplayers = manager_->NumPlayers();
+        std::vector<unsigned int>& offsets = eval_->offsets;
+        manager_->GetLegalMoves(*state_, eval_->legals);
+        offsets.assign(numplayers + 1, 0);
+        BOOST_FOREACH(const hsfcLegalMove& lm, eval_->legals)
+        {
+            if ((unsigned int)lm.RoleIndex < numplayers) ++offsets[lm.RoleIndex + 1];
+        }
+        for (unsigned int r = 0; r < numplayers; ++r)
+        {
+            if (offsets[r + 1] == 0)
+            {
+                eval_->legals.clear();
+                offsets.clear();
+                throw HSFCInternalError()
+                    << ErrorMsgInfo("HSFC internal error: missing moves for some players");
+            }
+            offsets[r + 1] += offsets[r];
+        }
+        std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+        eval_->byrole.resize(offsets[numplayers]);
+        for (unsigned int k = 0; k < eval_->legals.size(); ++k)
+        {
+            unsigned int r = (unsigned int)eval_->legals[k].RoleIndex;
+            if (r < numplayers) eval_->byrole[next[r]++] = k;
+        }
+    }
+    eval_->done = true;
+    return *eval_;
+}
 
-        delete state_;
-        state_ = NULL;
+void State::evaluate_legals(unsigned int roleid, std::vector<hsfcLegalMove>& dest) const
+{
+    boost::mutex::scoped_lock lock(eval_->mutex);
+    if (!eval_->checked) eval_->terminal = manager_->IsTerminal(*state_);
+    eval_->checked = true;
+    if (eval_->terminal)
+        throw HSFCValueError() << ErrorMsgInfo("Cannot call legals() on a terminal state");
+
+    dest.clear();
+    if (eval_->done)
+    {
+        for (unsigned int k = eval_->offsets[roleid]; k < eval_->offsets[roleid + 1]; ++k)
+        {
+            dest.push_back(eval_->legals[eval_->byrole[k]]);
+        }
+        return;
     }
+    manager_->GetLegalMoves(*state_, roleid, dest);
+    if (dest.empty())
+    {
+        throw HSFCInternalError()
+            << ErrorMsgInfo("HSFC internal error: missing moves for the player");
+    }
+}
+
+unsigned int State::evaluate_goal(unsigned int roleid) const
+{
+    boost::mutex::scoped_lock lock(eval_->mutex);
+    if (!eval_->checked) eval_->terminal = manager_->IsTerminal(*state_);
+    eval_->checked = true;
+    if (!eval_->terminal)
+        throw HSFCValueError() << ErrorMsgInfo("Cannot call goal() on a non-terminal state");
+
+    if (eval_->done) return (unsigned int)eval_->goals[roleid];
+    return (unsigned int)manager_->GetGoalValue(*state_, roleid);
+}
+
+void State::detach()
+{
+    if (state_.unique()) return;
+
+    // Nothing else changes the shared state once it has been evaluated
+    evaluate();
+
+    // The copy overwrites everything so the state needn't be reset first
+    boost::shared_ptr<hsfcState> copy(acquire_state(manager_));
+    manager_->CopyGameState(*copy, *state_);
+    state_ = copy;
+}
+
+void State::changed()
+{
+    eval_ = boost::make_shared<Evaluation>();
 }
 
 bool State::isTerminal() const
 {
-    return manager_->IsTerminal(*state_);
+    return evaluate().terminal;
 }
 
 boost::unordered_map<Player, std::vector<Move> > State::legals() const {
@@ -548,30 +890,41 @@ boost::unordered_map<Player, std::vector<Move> > State::legals() const {
 }
 
 std::vector<JointMove> State::joints() const {
-    const boost::unordered_map<Player, std::vector<Move> > inputs(legals());
-
-    std::vector<JointMove> result (1, boost::unordered_map<Player, Move>());
-
-    for (boost::unordered_map<Player, std::vector<Move> >::const_iterator iterInput = inputs.begin(); iterInput != inputs.end(); iterInput++) {
-        std::vector<JointMove> new_result;
-        for (std::vector<JointMove>::iterator iterResult = result.begin(); iterResult != result.end(); iterResult++) {
-            for (std::vector<Move>::const_iterator iterMove = iterInput->second.begin(); iterMove != (*iterInput).second.end(); iterMove++) {
-                JointMove tuple (*iterResult);
-                tuple.emplace(iterInput->first, *iterMove);
-                new_result.push_back(tuple);
-            }
-        }
-        result = new_result;
+    JointMoves jmoves(this->jointMoves());
+    std::vector<JointMove> result;
+    result.reserve(jmoves.size());
+    for (std::size_t i = 0; i < jmoves.size(); ++i) {
+        result.push_back(jmoves[i]);
     }
     return result;
 }
 
+JointMoves State::jointMoves() const {
+    const Evaluation& eval = evaluate();
+    if (eval.terminal)
+        throw HSFCValueError() << ErrorMsgInfo("Cannot call jointMoves() on a terminal state");
+    return JointMoves(manager_.get(), eval_);
+}
+
 JointGoal State::goals() const {
     JointGoal result;
     this->goals(std::inserter(result, result.begin()));
     return result;
 }
 
+void State::goals(JointGoalArray& dest) const {
+    const Evaluation& eval = evaluate();
+    if (!eval.terminal)
+        throw HSFCValueError() << ErrorMsgInfo("Cannot call goals() on a non-terminal state");
+    dest.assign(manager_.get(), eval.goals);
+}
+
+unsigned int State::goal(const Player& player) const {
+    if (player.manager_ != manager_.get())
+        throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+    return evaluate_goal(player.roleid_);
+}
+
 std::vector<Fluent> State::fluents() const {
     std::vector<Fluent> result;
     this->fluents(std::inserter(result, result.begin()));
@@ -589,6 +942,174 @@ JointGoal State::playout() {
     return result;
 }
 
+void State::playout(JointGoalArray& dest)
+{
+    std::vector<int> vals;
+    if (this->isTerminal())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot playout() on a terminal state");
+    detach();
+    manager_->PlayOut(*state_, vals);
+    changed();
+    this->check_playout(vals);
+    dest.assign(manager_.get(), vals);
+}
+
+void State::playout(std::vector<PlayerGoal>& results, unsigned int seed)
+{
+    this->playout(std::back_inserter(results), seed);
+}
+
+void State::playout(std::vector<PlayerGoal>& results, hsfcPolicy& policy)
+{
+    this->playout(std::back_inserter(results), policy);
+}
+
+void State::check_playout(const std::vector<int>& vals) const
+{
+    if (vals.size() != manager_->NumPlayers())
+    {
+        throw HSFCInternalError()
+            << ErrorMsgInfo("HSFC internal error: no goal value for some players");
+    }
+
+    // Not sure if this is necessary, but added a test for termination
+    // because it turns out that checking for termination does change
+    // some internal structures in the state.
+    if (!this->isTerminal())
+        throw HSFCInternalError() << ErrorMsgInfo("State is not terminal after a playout()");
+}
+
+void State::playout(std::vector<PlayerGoal>& results, std::vector<unsigned int>& trajectory,
+                    hsfcPolicy* policy)
+{
+    std::vector<int> vals;
+    if (this->isTerminal())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot playout() on a terminal state");
+    detach();
+    manager_->PlayOut(*state_, vals, policy, trajectory);
+    changed();
+    this->playout_goals(vals, std::back_inserter(results));
+}
+
+/*****************************************************************************************
+ * One thread's share of a batch of playouts. The root state is only ever copied from so
+ * any number of workers can share it. Each worker uses its own states and engine context
+ * (through the manager's per-thread data) and its own statistics.
+ *****************************************************************************************/
+namespace
+{
+struct PlayoutWorker
+{
+    HSFCManager* manager;
+    const hsfcState* root;
+    const std::vector<std::vector<hsfcLegalMove> >* joints;
+    unsigned int count;
+    std::size_t first;          // Where this worker's leftover playouts start
+    unsigned int seed;
+    std::vector<hsfcPlayOutStats> stats;
+    std::string error;
+
+    void operator()()
+    {
+        try
+        {
+            run();
+        } catch (std::exception& e)
+        {
+            error = e.what();
+        } catch (...)
+        {
+            error = "Unknown error in a playout thread";
+        }
+    }
+
+    void run()
+    {
+        // Every first joint move gets an equal share of the playouts and the
+        // leftovers go one each to the joint moves from first on
+        std::size_t n = joints->size();
+        std::vector<unsigned int> picks(n, count / n);
+        for (std::size_t i = 0; i < count % n; ++i) ++picks[(first + i) % n];
+
+        // Every playout that starts with the same joint move starts from the same state
+        manager->SeedRandom(seed);
+        hsfcState* next = manager->AcquireGameState();
+        for (std::size_t j = 0; j < joints->size(); ++j)
+        {
+            if (picks[j] == 0) continue;
+            manager->CopyGameState(*next, *root);
+            manager->DoMove(*next, (*joints)[j]);
+            manager->PlayOuts(*next, picks[j], stats[j]);
+        }
+        manager->ReleaseGameState(next);
+    }
+};
+}
+
+PlayoutResults State::playouts(unsigned int count, unsigned int threads,
+                               unsigned int seed) const
+{
+    if (this->isTerminal())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot playouts() on a terminal state");
+
+    PlayoutResults results;
+    JointMoves jmoves(this->jointMoves());
+    std::vector<std::vector<hsfcLegalMove> > joints(jmoves.size());
+    for (std::size_t j = 0; j < jmoves.size(); ++j)
+    {
+        jmoves.legals(j, joints[j]);
+    }
+
+    if (threads == 0) threads = std::max(1u, boost::thread::hardware_concurrency());
+    if (threads > count) threads = std::max(1u, count);
+
+    // The calling thread takes the first share of the work. Each worker's
+    // leftovers start where the previous worker's stopped, so that between
+    // them the joint moves get the same number of playouts give or take one.
+    std::vector<PlayoutWorker> workers(threads);
+    std::size_t first = 0;
+    for (unsigned int w = 0; w < threads; ++w)
+    {
+        std::size_t s = seed;
+        boost::hash_combine(s, w);
+        workers[w].manager = manager_.get();
+        workers[w].root = state_.get();
+        workers[w].joints = &joints;
+        workers[w].count = count / threads + (w < count % threads ? 1 : 0);
+        workers[w].first = first;
+        first = (first + workers[w].count % joints.size()) % joints.size();
+        workers[w].seed = (unsigned int)s;
+        workers[w].stats.resize(joints.size(), hsfcPlayOutStats());
+    }
+    boost::thread_group group;
+    for (unsigned int w = 1; w < threads; ++w)
+    {
+        group.create_thread(boost::ref(workers[w]));
+    }
+    workers[0]();
+    group.join_all();
+
+    results.moves_.reserve(jmoves.size());
+    for (std::size_t j = 0; j < jmoves.size(); ++j)
+    {
+        results.moves_.push_back(std::make_pair(jmoves[j], PlayoutStats()));
+    }
+    BOOST_FOREACH(const PlayoutWorker& worker, workers)
+    {
+        if (!worker.error.empty())
+            throw HSFCInternalError() << ErrorMsgInfo(worker.error);
+        for (std::size_t j = 0; j < joints.size(); ++j)
+        {
+            results.moves_[j].second.merge(PlayoutStats(worker.stats[j]));
+        }
+    }
+    for (std::size_t j = 0; j < joints.size(); ++j)
+    {
+        results.total_.merge(results.moves_[j].second);
+    }
+    return results;
+}
+
 
 void State::play(const std::vector<PlayerMove>& moves)
 {
@@ -600,43 +1121,68 @@ void State::play(const JointMove& moves)
     this->play(moves.begin(), moves.end());
 }
 
-/***********************************************************************
- * Internal format to return the legals in a structure that is easy
- * to check if some move is legal.
- ***********************************************************************/
-void State::get_legals(boost::unordered_map<Player, boost::unordered_set<Move> >& result) const
+void State::play(const JointMoveArray& moves)
 {
-    typedef boost::unordered_map<Player, boost::unordered_set<Move> > tmp_t;
+    std::vector<hsfcLegalMove> lms;
+    if (this->isTerminal())
+        throw HSFCValueError() << ErrorMsgInfo("Cannot play() on a terminal state");
+    if (moves.manager_ != NULL && moves.manager_ != manager_.get())
+        throw HSFCValueError() << ErrorMsgInfo("JointMoveArray is from a different game");
+    if (!moves.complete())
+        throw HSFCValueError() << ErrorMsgInfo("Must be exactly one move per player");
+    moves.legals(lms);
+    BOOST_FOREACH(const hsfcLegalMove& lm, lms)
+    {
+        if (!manager_->IsLegalMove(*state_, lm))
+            throw HSFCValueError() << ErrorMsgInfo("Illegal PlayerMove: unknown move");
+    }
+    detach();
+    manager_->DoMove(*state_, lms);
+    changed();
+}
 
-    result.clear();
-    std::vector<PlayerMove> legalMoves;
-    legals(std::back_inserter(legalMoves));
+void State::playUnchecked(const JointMove& moves)
+{
+    this->playUnchecked(moves.begin(), moves.end());
+}
 
-    for(std::vector<PlayerMove>::iterator pm = legalMoves.begin(); pm != legalMoves.end(); pm++) {
-        tmp_t::iterator iter_moves(result.find(pm->first));
-        if(iter_moves == result.end()) {
-            std::pair<tmp_t::iterator, bool> ok = result.emplace(pm->first, boost::unordered_set<Move>());
-            ok.first->second.emplace(pm->second);
-        } else {
-            iter_moves->second.emplace(pm->second);
-        }
-    }
+void State::playUnchecked(const JointMoveArray& moves)
+{
+    std::vector<hsfcLegalMove> lms;
+    moves.legals(lms);
+    detach();
+    manager_->AdvanceToLegals(*state_);
+    manager_->DoMove(*state_, lms);
+    changed();
+}
+
+void State::play(std::size_t index)
+{
+    std::vector<hsfcLegalMove> lms;
+    this->jointMoves().legals(index, lms);
+    detach();
+    manager_->DoMove(*state_, lms);
+    changed();
 }
 
-void State::throw_on_illegal_move(const PlayerMove& pm,
-                                  boost::unordered_map<Player, boost::unordered_set<Move> >& legals) const
+/***********************************************************************
+ * Internal format to return the legals in a structure that is easy
+ * to check if some move is legal.
+ ***********************************************************************/
+void State::throw_on_illegal_move(const PlayerMove& pm) const
 {
-    typedef boost::unordered_map<Player, boost::unordered_set<Move> > tmp_t;
     const Player& p = pm.first;
     const Move& m = pm.second;
 
-    tmp_t::const_iterator itp(legals.find(p));
-    if (itp == legals.end())
+    if (p.manager_ != manager_.get() || p.roleid_ >= manager_->NumPlayers())
     {
         throw HSFCValueError() << ErrorMsgInfo("Illegal PlayerMove: unknown player");
     }
-    boost::unordered_set<Move>::const_iterator itm(itp->second.find(m));
-    if (itm == itp->second.end())
+
+    // The legal moves of a state are looked up rather than listed
+    hsfcLegalMove lm = m.move_;
+    lm.RoleIndex = p.roleid_;
+    if (m.manager_ != manager_.get() || !manager_->IsLegalMove(*state_, lm))
     {
         throw HSFCValueError() << ErrorMsgInfo("Illegal PlayerMove: unknown move");
     }
@@ -652,5 +1198,97 @@ std::ostream& operator<<(std::ostream& os, const State& state)
     return state.manager_->PrintState(os, *(state.state_));
 }
 
+/*****************************************************************************************
+ * Implementation of JointMoves
+ *****************************************************************************************/
+
+JointMoves::JointMoves(const HSFCManager* manager,
+                       boost::shared_ptr<const State::Evaluation> eval) :
+    manager_(manager), eval_(eval), size_(1)
+{
+    const std::vector<unsigned int>& offsets = eval_->offsets;
+    for (unsigned int r = 0; r + 1 < offsets.size(); ++r)
+    {
+        std::size_t n = offsets[r + 1] - offsets[r];
+        if (size_ > std::numeric_limits<std::size_t>::max() / n)
+            throw HSFCValueError() << ErrorMsgInfo("Too many joint moves to index");
+        size_ *= n;
+    }
+}
+
+std::size_t JointMoves::size() const
+{
+    return size_;
+}
+
+std::size_t JointMoves::numMoves(const Player& player) const
+{
+    if (player.manager_ != manager_ || player.roleid_ >= manager_->NumPlayers())
+        throw HSFCValueError() << ErrorMsgInfo("Player is from a different game");
+    return eval_->offsets[player.roleid_ + 1] - eval_->offsets[player.roleid_];
+}
+
+JointMove JointMoves::operator[](std::size_t index) const
+{
+    JointMove result;
+    this->moves(index, std::inserter(result, result.begin()));
+    return result;
+}
+
+void JointMoves::get(std::size_t index, JointMoveArray& dest) const
+{
+    const std::vector<unsigned int>& offsets = eval_->offsets;
+    unsigned int numplayers = offsets.size() - 1;
+    std::size_t n = 0;
+
+    if (index >= size_)
+        throw HSFCValueError() << ErrorMsgInfo("Joint move index out of range");
+    if (numplayers > JointMoveArray::MaxPlayers)
+        throw HSFCValueError() << ErrorMsgInfo("Too many players for a JointMoveArray");
+
+    dest.manager_ = manager_;
+    dest.size_ = numplayers;
+    dest.set_ = (1u << numplayers) - 1;
+    for (unsigned int r = numplayers; r-- > 0; )
+    {
+        n = offsets[r + 1] - offsets[r];
+        dest.moves_[r] = eval_->legals[eval_->byrole[offsets[r] + index % n]].Tuple;
+        index /= n;
+    }
+}
+
+const hsfcLegalMove& JointMoves::legal(std::size_t index, unsigned int roleid) const
+{
+    const std::vector<unsigned int>& offsets = eval_->offsets;
+    std::size_t n = 0;
+
+    // Drop the digits of the later players
+    for (unsigned int r = offsets.size() - 2; r > roleid; --r)
+    {
+        index /= offsets[r + 1] - offsets[r];
+    }
+    n = offsets[roleid + 1] - offsets[roleid];
+    return eval_->legals[eval_->byrole[offsets[roleid] + index % n]];
+}
+
+void JointMoves::legals(std::size_t index, std::vector<hsfcLegalMove>& dest) const
+{
+    const std::vector<unsigned int>& offsets = eval_->offsets;
+    unsigned int numplayers = offsets.size() - 1;
+    std::size_t n = 0;
+
+    if (index >= size_)
+        throw HSFCValueError() << ErrorMsgInfo("Joint move index out of range");
+
+    // The digits are taken from the last player back
+    dest.resize(numplayers);
+    for (unsigned int r = numplayers; r-- > 0; )
+    {
+        n = offsets[r + 1] - offsets[r];
+        dest[r] = eval_->legals[eval_->byrole[offsets[r] + index % n]];
+        index /= n;
+    }
+}
+
 
 }; /* namespace HSFC */
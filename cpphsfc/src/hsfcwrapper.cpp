@@ -6,6 +6,8 @@
 #include <boost/variant/get.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <hsfc/impl/hsfcwrapper.h>
 #include <hsfc/hsfcexception.h>
@@ -14,13 +16,51 @@
 namespace HSFC
 {
 
+/*****************************************************************************************
+ * Each thread maps a manager's pool id to its own data for that manager. Ids are never
+ * reused so the entry left behind by a destroyed manager is never found again. The
+ * entries share ownership with the manager: once a thread has exited the manager holds
+ * the only reference and can hand the data on, and once the manager has been destroyed
+ * the thread holds the only reference and can drop the entry.
+ *****************************************************************************************/
+namespace
+{
+typedef std::map<unsigned long, boost::shared_ptr<void> > local_pools_t;
+boost::thread_specific_ptr<local_pools_t> local_pools;
+boost::mutex poolid_mutex;
+unsigned long next_poolid = 0;
+
+// Beyond this many free states per thread a released state is freed
+const std::size_t MAX_POOLED_STATES = 64;
+}
+
 /*****************************************************************************************
  * Implementation of HSFCManager
  *****************************************************************************************/
 
 HSFCManager::HSFCManager() :
     internal_(new hsfcGDLManager()), params_(new hsfcGDLParameters())
-{  }
+{
+    boost::lock_guard<boost::mutex> guard(poolid_mutex);
+    poolid_ = next_poolid++;
+}
+
+HSFCManager::~HSFCManager()
+{
+    boost::lock_guard<boost::mutex> guard(poolmutex_);
+    BOOST_FOREACH(boost::shared_ptr<ThreadData>& data, threaddata_)
+    {
+        BOOST_FOREACH(hsfcState* state, data->pool)
+        {
+            internal_->FreeGameState(state);
+            delete state;
+        }
+        data->pool.clear();
+        if (data->context != NULL)
+            internal_->FreeContext(data->context);
+        data->context = NULL;
+    }
+}
 
 /*****************************************************************************************
  * Internal extra functions.
@@ -110,6 +150,94 @@ void HSFCManager::CopyGameState(hsfcState& Destination, const hsfcState& Source)
     internal_->CopyGameState(&Destination, &tmp);
 }
 
+/*****************************************************************************************
+ * Per-thread state pool and context
+ *****************************************************************************************/
+
+HSFCManager::ThreadData& HSFCManager::LocalData() const
+{
+    local_pools_t* pools = local_pools.get();
+    if (pools == NULL)
+    {
+        pools = new local_pools_t();
+        local_pools.reset(pools);
+    }
+
+    local_pools_t::iterator iter = pools->find(poolid_);
+    if (iter != pools->end())
+        return *static_cast<ThreadData*>(iter->second.get());
+
+    // First use of this manager by this thread. Drop the entries of managers
+    // that have since been destroyed.
+    for (iter = pools->begin(); iter != pools->end(); )
+    {
+        if (iter->second.unique())
+            pools->erase(iter++);
+        else
+            ++iter;
+    }
+
+    // Take over the data of a thread that has exited if there is one,
+    // otherwise start afresh.
+    boost::shared_ptr<ThreadData> data;
+    {
+        boost::lock_guard<boost::mutex> guard(poolmutex_);
+        BOOST_FOREACH(boost::shared_ptr<ThreadData>& td, threaddata_)
+        {
+            if (td.use_count() == 1)
+            {
+                data = td;
+                break;
+            }
+        }
+        if (!data)
+        {
+            data.reset(new ThreadData());
+            data->context = NULL;
+            threaddata_.push_back(data);
+        }
+    }
+    pools->insert(std::make_pair(poolid_, boost::shared_ptr<void>(data)));
+    return *data;
+}
+
+hsfcContext* HSFCManager::LocalContext() const
+{
+    ThreadData& data = LocalData();
+    if (data.context == NULL)
+    {
+        // The engine numbers its contexts to seed them so creation is serialised
+        boost::lock_guard<boost::mutex> guard(poolmutex_);
+        data.context = internal_->CreateContext();
+        if (data.context == NULL)
+            throw HSFCInternalError() << ErrorMsgInfo("Failed to create HSFC context");
+    }
+    return data.context;
+}
+
+hsfcState* HSFCManager::AcquireGameState()
+{
+    std::vector<hsfcState*>& pool = LocalData().pool;
+    if (pool.empty())
+        return this->CreateGameState();
+
+    hsfcState* state = pool.back();
+    pool.pop_back();
+    return state;
+}
+
+void HSFCManager::ReleaseGameState(hsfcState* GameState)
+{
+    std::vector<hsfcState*>& pool = LocalData().pool;
+    if (pool.size() < MAX_POOLED_STATES)
+    {
+        pool.push_back(GameState);
+        return;
+    }
+    this->FreeGameState(GameState);
+    delete GameState;
+}
+
 void HSFCManager::SetInitialGameState(hsfcState& GameState)
 {
     internal_->SetInitialGameState(&GameState);
@@ -119,7 +247,7 @@ void HSFCManager::GetLegalMoves(const hsfcState& GameState,
                                 std::vector<hsfcLegalMove>& LegalMove) const
 {
     std::vector<std::vector<hsfcLegalMove> > tmp;
-    internal_->GetLegalMoves(const_cast<hsfcState*>(&GameState), tmp);
+    internal_->GetLegalMoves(const_cast<hsfcState*>(&GameState), tmp, LocalContext());
 
     BOOST_FOREACH(std::vector<hsfcLegalMove>& v, tmp)
     {
@@ -130,25 +258,86 @@ void HSFCManager::GetLegalMoves(const hsfcState& GameState,
     }
 }
 
+void HSFCManager::GetLegalMoves(const hsfcState& GameState, unsigned int RoleIndex,
+                                std::vector<hsfcLegalMove>& LegalMove) const
+{
+    internal_->GetLegalMoves(const_cast<hsfcState*>(&GameState), RoleIndex, LegalMove,
+                             LocalContext());
+}
+
+bool HSFCManager::IsLegalMove(const hsfcState& GameState, const hsfcLegalMove& LegalMove) const
+{
+    return internal_->IsLegalMove(const_cast<hsfcState*>(&GameState),
+                                  const_cast<hsfcLegalMove&>(LegalMove), LocalContext());
+}
+
 void HSFCManager::DoMove(hsfcState& GameState, const std::vector<hsfcLegalMove>& LegalMove)
 {
-    internal_->DoMove(&GameState, const_cast<std::vector<hsfcLegalMove>&>(LegalMove));
+    internal_->DoMove(&GameState, const_cast<std::vector<hsfcLegalMove>&>(LegalMove),
+                      LocalContext());
+}
+
+void HSFCManager::AdvanceToLegals(hsfcState& GameState) const
+{
+    // The demand driven queries run strata without moving the step on, so the
+    // step is all that tells whether the legal relation is ready for DoMove
+    if (GameState.CurrentStep < 1)
+        internal_->RulesEngine->AdvanceState(&GameState, 1, false, LocalContext());
+    if (GameState.CurrentStep < 2)
+        internal_->RulesEngine->AdvanceState(&GameState, 2, false, LocalContext());
 }
 
 bool HSFCManager::IsTerminal(const hsfcState& GameState) const
 {
-    return internal_->IsTerminal(const_cast<hsfcState*>(&GameState));
+    return internal_->IsTerminal(const_cast<hsfcState*>(&GameState), LocalContext());
 }
 
 void HSFCManager::GetGoalValues(const hsfcState& GameState,
                                 std::vector<int>& GoalValue) const
 {
-    internal_->GetGoalValues(const_cast<hsfcState*>(&GameState), GoalValue);
+    internal_->GetGoalValues(const_cast<hsfcState*>(&GameState), GoalValue, LocalContext());
+}
+
+int HSFCManager::GetGoalValue(const hsfcState& GameState, unsigned int RoleIndex) const
+{
+    return internal_->GetGoalValue(const_cast<hsfcState*>(&GameState), RoleIndex, LocalContext());
 }
 
 void HSFCManager::PlayOut(hsfcState& GameState, std::vector<int>& GoalValue)
 {
-    internal_->PlayOut(&GameState, GoalValue);
+    internal_->PlayOut(&GameState, GoalValue, LocalContext());
+}
+
+void HSFCManager::PlayOut(hsfcState& GameState, std::vector<int>& GoalValue,
+                          unsigned int Seed)
+{
+    internal_->PlayOut(&GameState, GoalValue, Seed, LocalContext());
+}
+
+void HSFCManager::PlayOut(hsfcState& GameState, std::vector<int>& GoalValue,
+                          hsfcPolicy& Policy)
+{
+    internal_->PlayOut(&GameState, GoalValue, &Policy, LocalContext());
+}
+
+void HSFCManager::PlayOut(hsfcState& GameState, std::vector<int>& GoalValue,
+                          hsfcPolicy* Policy, std::vector<unsigned int>& Trajectory)
+{
+    internal_->PlayOut(&GameState, GoalValue, Policy, &Trajectory, NULL, LocalContext());
+}
+
+void HSFCManager::SeedRandom(unsigned int Seed)
+{
+    internal_->SeedRandom(Seed, LocalContext());
+}
+
+void HSFCManager::PlayOuts(const hsfcState& GameState, unsigned int NumPlayOuts,
+                           hsfcPlayOutStats& Stats)
+{
+    hsfcState* scratch = this->AcquireGameState();
+    internal_->PlayOuts(const_cast<hsfcState*>(&GameState), scratch, NumPlayOuts, Stats,
+                        LocalContext());
+    this->ReleaseGameState(scratch);
 }
 
 void HSFCManager::DisplayState(const hsfcState& GameState, bool rigids) const
@@ -230,43 +419,45 @@ std::ostream& HSFCManager::PrintPlayer(std::ostream& os, unsigned int roleid) co
  *****************************************************************************************/
 
 
-struct gdl_move_visitor : public boost::static_visitor<std::ostream&>
-{
-    std::ostream& os_;
-    gdl_move_visitor(std::ostream& os) : os_(os){}
-    std::ostream& operator()(const std::string& name) { return os_ << name; }
-    std::ostream& operator()(const SubTerms& ts){ return generate_sexpr(ts, os_); }
-};
-
-std::ostream& HSFCManager::PrintMove(std::ostream& os, const hsfcLegalMove& legalmove) const
+// The text of a relation is rendered the first time it is asked for and then
+// kept for the life of the game. For a move only the action part of the
+// "(does <role> <action>)" text is kept.
+const std::string& HSFCManager::RelationText(const hsfcTuple& tuple, bool action) const
 {
-    try
+    TextKey key(tuple.Index, tuple.ID);
     {
-        Term term;
-        internal_->GetMoveText(const_cast<hsfcLegalMove&>(legalmove));
-        parse_sexpr(legalmove.Text,term);
+        boost::shared_lock<boost::shared_mutex> lock(textmutex_);
+        boost::unordered_map<TextKey, std::string>::const_iterator it = text_.find(key);
+        if (it != text_.end()) return it->second;
+    }
 
-        if (SubTerms* ts = boost::get<SubTerms>(&term))
-        {
-            if (ts->children_.size() != 3)
-                throw HSFCInternalError()
-                    << ErrorMsgInfo("HSFC internal error: move_.Text term not arity 3");
-            if (boost::get<std::string>(ts->children_[0]) != "does")
-                throw HSFCInternalError()
-                    << ErrorMsgInfo("HSFC internal error: move_.Text not 'does' relation");
-            gdl_move_visitor gmv(os);
-            boost::apply_visitor(gmv, ts->children_[2]);
-            return os;
-        }
-        else
-        {
-            throw HSFCInternalError()
-                << ErrorMsgInfo("HSFC internal error: move_.Text term is not a 'does' relation");
-        }
-    } catch (HSFCException& e)
+    std::string text;
+    hsfcTuple tmp = tuple;
+    internal_->GetMoveText(tmp, text);
+    if (action)
     {
-        throw HSFCInternalError() << ErrorMsgInfo(e.what());
+        // The role is a single name, so the action follows the second space
+        static const std::string prefix("(does ");
+        std::string::size_type pos = text.find(' ', prefix.size());
+        if (text.compare(0, prefix.size(), prefix) != 0 ||
+            pos == std::string::npos || text[text.size() - 1] != ')')
+            throw HSFCInternalError()
+                << ErrorMsgInfo("HSFC internal error: move text is not a 'does' relation");
+        text = text.substr(pos + 1, text.size() - pos - 2);
     }
+
+    boost::unique_lock<boost::shared_mutex> lock(textmutex_);
+    return text_.insert(std::make_pair(key, text)).first->second;
+}
+
+std::ostream& HSFCManager::PrintMove(std::ostream& os, const hsfcLegalMove& legalmove) const
+{
+    return os << RelationText(legalmove.Tuple, true);
+}
+
+const std::string& HSFCManager::MoveText(const hsfcLegalMove& legalmove) const
+{
+    return RelationText(legalmove.Tuple, true);
 }
 
 
@@ -315,9 +506,16 @@ void HSFCManager::SetStateData(const std::set<std::pair<int,int> >& relationset,
 
 }
 
+std::ostream& HSFCManager::PrintFluent(std::ostream& os, const hsfcTuple& fluent) const {
+  return os << RelationText(fluent, false);
+}
+
+const std::string& HSFCManager::FluentText(const hsfcTuple& fluent) const {
+  return RelationText(fluent, false);
+}
+
 void HSFCManager::PrintFluent(const hsfcTuple& fluent, std::string& text) const {
-  hsfcTuple& tmp = const_cast<hsfcTuple&>(fluent);
-  internal_->GetMoveText(tmp, text);
+  text = RelationText(fluent, false);
 }
 
 void HSFCManager::GetFluents(const hsfcState& state, std::vector<hsfcTuple>& fluents) const {
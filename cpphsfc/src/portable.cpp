@@ -17,6 +17,8 @@ PortableState::PortableState() : round_(0), currentstep_(0)
 
 PortableState::PortableState(const State& state)
 {
+    // Record the state as evaluated so that equal states give equal portable states
+    state.evaluate();
     state.manager_->GetStateData(*state.state_, relationset_, round_, currentstep_);
 }
 
@@ -126,11 +128,7 @@ PortableMove::PortableMove(const Move& move) :
 #else
     RelationIndex_(move.move_.Tuple.Index)
 #endif
-{
-#if HSFC_VERSION > 1
-    if (move.move_.Text != NULL) Text_ = move.move_.Text;
-#endif
- }
+{ }
 
 PortableMove::PortableMove(const PortableMove& other) :
     RoleIndex_(other.RoleIndex_), Text_(other.Text_),
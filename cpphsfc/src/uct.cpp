@@ -0,0 +1,453 @@
+#include <cmath>
+#include <string>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <hsfc/uct.h>
+
+namespace HSFC
+{
+
+/*****************************************************************************************
+ * A node of the tree. The legal moves are filled in (expanded) by the first iteration
+ * that goes through the node; the terminal flag and goals are known when it is created.
+ * Everything except the terminal flag and goals is guarded by the node's mutex.
+ *****************************************************************************************/
+namespace
+{
+struct Choice
+{
+    hsfcLegalMove move;
+    unsigned int visits;
+    double total;
+};
+}
+
+struct UCTSearch::Node
+{
+    boost::mutex mutex;
+    bool terminal;
+    std::vector<int> goals;
+    bool expanded;
+    unsigned int visits;
+    std::vector<std::vector<Choice> > choices;      // Indexed by role
+    boost::unordered_map<std::size_t, Node*> children;  // Keyed by joint move index
+
+    Node() : terminal(false), expanded(false), visits(0) { }
+    ~Node()
+    {
+        typedef std::pair<const std::size_t, Node*> child_t;
+        BOOST_FOREACH(child_t& child, children)
+        {
+            delete child.second;
+        }
+    }
+
+    // The joint move index made up from a move index for each role
+    std::size_t key(const std::vector<unsigned int>& picked) const
+    {
+        std::size_t k = 0;
+        for (unsigned int r = 0; r < choices.size(); ++r)
+        {
+            k = k * choices[r].size() + picked[r];
+        }
+        return k;
+    }
+
+    std::size_t size() const
+    {
+        std::size_t s = 1;
+        typedef std::pair<const std::size_t, Node*> child_t;
+        BOOST_FOREACH(const child_t& child, children)
+        {
+            s += child.second->size();
+        }
+        return s;
+    }
+};
+
+/*****************************************************************************************
+ * A search thread. Each one has its own scratch state (taken from the manager's per-thread
+ * pool, as is the engine context) and its own seed for breaking ties and for the playouts.
+ *****************************************************************************************/
+struct UCTSearch::Worker
+{
+    UCTSearch* search;
+    boost::mutex* budgetmutex;
+    unsigned int* remaining;
+    bool limited;
+    boost::posix_time::ptime deadline;
+    unsigned int seed;
+    std::string error;
+
+    void operator()()
+    {
+        try
+        {
+            run();
+        } catch (std::exception& e)
+        {
+            error = e.what();
+        } catch (...)
+        {
+            error = "Unknown error in a search thread";
+        }
+    }
+
+    bool more()
+    {
+        if (!deadline.is_not_a_date_time() &&
+            boost::posix_time::microsec_clock::universal_time() >= deadline)
+            return false;
+        if (!limited) return true;
+
+        boost::lock_guard<boost::mutex> guard(*budgetmutex);
+        if (*remaining == 0) return false;
+        --(*remaining);
+        return true;
+    }
+
+    void run()
+    {
+        HSFCManager& manager = *(search->root_.manager_);
+        boost::random::mt19937 gen(seed);
+        manager.SeedRandom(seed);
+        hsfcState* scratch = manager.AcquireGameState();
+        try
+        {
+            while (more()) iterate(manager, *scratch, gen);
+        } catch (...)
+        {
+            manager.ReleaseGameState(scratch);
+            throw;
+        }
+        manager.ReleaseGameState(scratch);
+    }
+
+    // Pick a player's move by UCB1, trying each move once first
+    unsigned int select(const Node& node, unsigned int r, boost::random::mt19937& gen)
+    {
+        const std::vector<Choice>& choices = node.choices[r];
+        unsigned int unvisited = 0;
+        BOOST_FOREACH(const Choice& c, choices)
+        {
+            if (c.visits == 0) ++unvisited;
+        }
+        if (unvisited > 0)
+        {
+            boost::random::uniform_int_distribution<unsigned int> pick(0, unvisited - 1);
+            unsigned int n = pick(gen);
+            for (unsigned int i = 0; i < choices.size(); ++i)
+            {
+                if (choices[i].visits == 0 && n-- == 0) return i;
+            }
+        }
+
+        double logvisits = std::log((double)node.visits);
+        unsigned int best = 0;
+        double bestucb = -1;
+        for (unsigned int i = 0; i < choices.size(); ++i)
+        {
+            const Choice& c = choices[i];
+            double ucb = c.total / (100.0 * c.visits) +
+                search->exploration_ * std::sqrt(logvisits / c.visits);
+            if (ucb > bestucb)
+            {
+                best = i;
+                bestucb = ucb;
+            }
+        }
+        return best;
+    }
+
+    void expand(HSFCManager& manager, Node& node, const hsfcState& state)
+    {
+        std::vector<hsfcLegalMove> lms;
+        manager.GetLegalMoves(state, lms);
+        node.choices.resize(manager.NumPlayers());
+        BOOST_FOREACH(hsfcLegalMove& lm, lms)
+        {
+            Choice c;
+            c.move = lm;
+            c.move.Text = NULL;
+            c.visits = 0;
+            c.total = 0;
+            node.choices[lm.RoleIndex].push_back(c);
+        }
+        for (unsigned int r = 0; r < node.choices.size(); ++r)
+        {
+            if (node.choices[r].empty())
+                throw HSFCInternalError()
+                    << ErrorMsgInfo("HSFC internal error: missing moves for some players");
+        }
+        node.expanded = true;
+    }
+
+    // One iteration: select down to a new leaf, play out from it and back up the goals
+    void iterate(HSFCManager& manager, hsfcState& scratch, boost::random::mt19937& gen)
+    {
+        unsigned int numroles = manager.NumPlayers();
+        std::vector<Node*> path;
+        std::vector<unsigned int> picked;
+        std::vector<hsfcLegalMove> does;
+        std::vector<int> goals;
+
+        manager.CopyGameState(scratch, *(search->root_.state_));
+        Node* node = search->rootnode_;
+        while (true)
+        {
+            if (node->terminal)
+            {
+                goals = node->goals;
+                break;
+            }
+
+            Node* child = NULL;
+            std::size_t key;
+            does.clear();
+            {
+                boost::lock_guard<boost::mutex> guard(node->mutex);
+                if (!node->expanded) expand(manager, *node, scratch);
+
+                // Choose a move for each player and add the virtual loss
+                ++node->visits;
+                std::vector<unsigned int> step(numroles);
+                for (unsigned int r = 0; r < numroles; ++r)
+                {
+                    step[r] = select(*node, r, gen);
+                    Choice& c = node->choices[r][step[r]];
+                    ++c.visits;
+                    does.push_back(c.move);
+                    picked.push_back(step[r]);
+                }
+                key = node->key(step);
+                boost::unordered_map<std::size_t, Node*>::iterator iter = node->children.find(key);
+                if (iter != node->children.end()) child = iter->second;
+            }
+            path.push_back(node);
+
+            // Only expanding a node calculates the legal moves of the scratch
+            // state, which DoMove needs
+            manager.AdvanceToLegals(scratch);
+            manager.DoMove(scratch, does);
+            if (child != NULL)
+            {
+                node = child;
+                continue;
+            }
+
+            // Add a new leaf and evaluate it
+            Node* leaf = new Node();
+            leaf->terminal = manager.IsTerminal(scratch);
+            if (leaf->terminal) manager.GetGoalValues(scratch, leaf->goals);
+            {
+                boost::lock_guard<boost::mutex> guard(node->mutex);
+                if (!node->children.insert(std::make_pair(key, leaf)).second)
+                {
+                    delete leaf;
+                    leaf = node->children[key];
+                }
+            }
+            if (leaf->terminal) goals = leaf->goals;
+            else manager.PlayOut(scratch, goals);
+            break;
+        }
+
+        if (goals.size() != numroles)
+            throw HSFCInternalError()
+                << ErrorMsgInfo("HSFC internal error: no goal value for some players");
+
+        // Back up the goals; the visits were counted on the way down
+        for (unsigned int i = 0; i < path.size(); ++i)
+        {
+            boost::lock_guard<boost::mutex> guard(path[i]->mutex);
+            for (unsigned int r = 0; r < numroles; ++r)
+            {
+                path[i]->choices[r][picked[i * numroles + r]].total += goals[r];
+            }
+        }
+    }
+};
+
+/*****************************************************************************************
+ * Implementation of UCTSearch
+ *****************************************************************************************/
+
+UCTSearch::UCTSearch(const State& root, unsigned int threads, double exploration,
+                     unsigned int seed) :
+    root_(root), rootnode_(NULL), threads_(threads), exploration_(exploration),
+    seed_(seed), searches_(0)
+{
+    if (threads_ == 0) threads_ = std::max(1u, boost::thread::hardware_concurrency());
+    rootnode_ = newroot();
+}
+
+UCTSearch::~UCTSearch()
+{
+    delete rootnode_;
+}
+
+UCTSearch::Node* UCTSearch::newroot() const
+{
+    Node* node = new Node();
+    node->terminal = root_.isTerminal();
+    if (node->terminal) root_.manager_->GetGoalValues(*root_.state_, node->goals);
+    return node;
+}
+
+void UCTSearch::search(unsigned int iterations, double seconds)
+{
+    if (iterations == 0 && seconds <= 0)
+        throw HSFCValueError() << ErrorMsgInfo("A search needs an iteration or a time limit");
+    if (rootnode_->terminal)
+        throw HSFCValueError() << ErrorMsgInfo("Cannot search() from a terminal state");
+
+    boost::mutex budgetmutex;
+    unsigned int remaining = iterations;
+    std::vector<Worker> workers(threads_);
+    for (unsigned int w = 0; w < threads_; ++w)
+    {
+        std::size_t s = seed_;
+        boost::hash_combine(s, searches_);
+        boost::hash_combine(s, w);
+        workers[w].search = this;
+        workers[w].budgetmutex = &budgetmutex;
+        workers[w].remaining = &remaining;
+        workers[w].limited = iterations > 0;
+        if (seconds > 0)
+            workers[w].deadline = boost::posix_time::microsec_clock::universal_time() +
+                boost::posix_time::microseconds((long)(seconds * 1000000));
+        workers[w].seed = (unsigned int)s;
+    }
+    ++searches_;
+
+    // The calling thread is the first worker
+    boost::thread_group group;
+    for (unsigned int w = 1; w < threads_; ++w)
+    {
+        group.create_thread(boost::ref(workers[w]));
+    }
+    workers[0]();
+    group.join_all();
+
+    BOOST_FOREACH(const Worker& worker, workers)
+    {
+        if (!worker.error.empty())
+            throw HSFCInternalError() << ErrorMsgInfo(worker.error);
+    }
+}
+
+const UCTSearch::Node& UCTSearch::expandedroot() const
+{
+    if (!rootnode_->expanded)
+        throw HSFCValueError() << ErrorMsgInfo("No search has been run from the root");
+    return *rootnode_;
+}
+
+unsigned int UCTSearch::choice(const Node& node, const Player& player, const Move& move) const
+{
+    if (player.roleid_ >= node.choices.size() ||
+        (unsigned int)move.move_.RoleIndex != player.roleid_)
+        throw HSFCValueError() << ErrorMsgInfo("Not a move of the player at the root");
+
+    const std::vector<Choice>& choices = node.choices[player.roleid_];
+    for (unsigned int i = 0; i < choices.size(); ++i)
+    {
+        if (choices[i].move.Tuple.Index == move.move_.Tuple.Index &&
+            choices[i].move.Tuple.ID == move.move_.Tuple.ID)
+            return i;
+    }
+    throw HSFCValueError() << ErrorMsgInfo("Not a legal move at the root");
+}
+
+Move UCTSearch::best(const Player& player) const
+{
+    const Node& node = expandedroot();
+    if (player.roleid_ >= node.choices.size())
+        throw HSFCValueError() << ErrorMsgInfo("Not a player of the game");
+
+    const std::vector<Choice>& choices = node.choices[player.roleid_];
+    unsigned int best = 0;
+    for (unsigned int i = 1; i < choices.size(); ++i)
+    {
+        const Choice& c = choices[i];
+        const Choice& b = choices[best];
+        if (c.visits > b.visits ||
+            (c.visits == b.visits && c.total > b.total))
+            best = i;
+    }
+    return Move(root_.manager_.get(), choices[best].move);
+}
+
+JointMove UCTSearch::best() const
+{
+    JointMove result;
+    const Node& node = expandedroot();
+    for (unsigned int r = 0; r < node.choices.size(); ++r)
+    {
+        Player player(root_.manager_.get(), r);
+        result.emplace(player, best(player));
+    }
+    return result;
+}
+
+unsigned int UCTSearch::visits(const Player& player, const Move& move) const
+{
+    const Node& node = expandedroot();
+    return node.choices[player.roleid_][choice(node, player, move)].visits;
+}
+
+double UCTSearch::value(const Player& player, const Move& move) const
+{
+    const Node& node = expandedroot();
+    const Choice& c = node.choices[player.roleid_][choice(node, player, move)];
+    if (c.visits == 0) return 0;
+    return c.total / c.visits;
+}
+
+void UCTSearch::play(const JointMove& move)
+{
+    // Let State check the move is legal before the tree is touched
+    root_.play(move);
+
+    Node* next = NULL;
+    if (rootnode_->expanded)
+    {
+        std::vector<unsigned int> picked(rootnode_->choices.size());
+        BOOST_FOREACH(const JointMove::value_type& pm, move)
+        {
+            picked[pm.first.roleid_] = choice(*rootnode_, pm.first, pm.second);
+        }
+        std::size_t key = rootnode_->key(picked);
+        boost::unordered_map<std::size_t, Node*>::iterator iter = rootnode_->children.find(key);
+        if (iter != rootnode_->children.end())
+        {
+            next = iter->second;
+            rootnode_->children.erase(iter);
+        }
+    }
+    delete rootnode_;
+    rootnode_ = next != NULL ? next : newroot();
+}
+
+const State& UCTSearch::root() const
+{
+    return root_;
+}
+
+unsigned int UCTSearch::iterations() const
+{
+    return rootnode_->visits;
+}
+
+std::size_t UCTSearch::size() const
+{
+    return rootnode_->size();
+}
+
+}; /* namespace HSFC */
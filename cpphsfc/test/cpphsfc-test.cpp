@@ -12,6 +12,7 @@
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/function_output_iterator.hpp>
+#include <boost/type_traits.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <hsfc/hsfc.h>
 #include <hsfc/portable.h>
@@ -304,6 +305,138 @@ BOOST_AUTO_TEST_CASE(text_check)
     }
 }
 
+BOOST_AUTO_TEST_CASE(move_handles)
+{
+    Game game(g_tictactoe);
+    State state = game.initState();
+
+    std::vector<PlayerMove> legs;
+    state.legals(std::back_inserter(legs));
+    BOOST_REQUIRE(!legs.empty());
+
+    // Moves, players and fluents copy like plain data and print the same
+    // text on every call
+    BOOST_CHECK(boost::has_trivial_copy<Move>::value);
+    BOOST_CHECK(boost::has_trivial_destructor<Move>::value);
+    BOOST_CHECK(boost::has_trivial_copy<Player>::value);
+    BOOST_CHECK(boost::has_trivial_destructor<Player>::value);
+    BOOST_CHECK(boost::has_trivial_copy<Fluent>::value);
+    BOOST_CHECK(boost::has_trivial_destructor<Fluent>::value);
+    BOOST_FOREACH(const PlayerMove& pm, legs)
+    {
+        Move copy = pm.second;
+        BOOST_CHECK(copy == pm.second);
+        BOOST_CHECK_EQUAL(copy.tostring(), pm.second.tostring());
+        BOOST_CHECK_EQUAL(pm.second.tostring(), pm.second.tostring());
+        Player player = pm.first;
+        BOOST_CHECK(player == pm.first);
+        BOOST_CHECK_EQUAL(player.hash_value(), pm.first.hash_value());
+        BOOST_CHECK_EQUAL(player.tostring(), pm.first.tostring());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(joint_moves_view)
+{
+    Game game(g_tictactoe);
+    State state = game.initState();
+    std::vector<Player> players = game.players();
+
+    // One joint move for each of xplayer's moves and oplayer's noop
+    JointMoves view = state.jointMoves();
+    std::vector<JointMove> jms = state.joints();
+    BOOST_CHECK_EQUAL(view.size(), 9);
+    BOOST_CHECK_EQUAL(view.size(), jms.size());
+    BOOST_CHECK_EQUAL(view.numMoves(get_player(game, "xplayer")), 9);
+    BOOST_CHECK_EQUAL(view.numMoves(get_player(game, "oplayer")), 1);
+    for (std::size_t i = 0; i < view.size(); ++i)
+    {
+        BOOST_CHECK(view[i] == jms[i]);
+        std::vector<PlayerMove> pms;
+        view.moves(i, std::back_inserter(pms));
+        BOOST_CHECK_EQUAL(pms.size(), players.size());
+        BOOST_CHECK(JointMove(pms.begin(), pms.end()) == jms[i]);
+    }
+    BOOST_CHECK_THROW(view[view.size()], HSFCValueError);
+
+    // Playing by index is the same as playing the joint move
+    State byindex(state);
+    State byjoint(state);
+    byindex.play(4);
+    byjoint.play(jms[4]);
+    BOOST_CHECK(byindex.fluents() == byjoint.fluents());
+    BOOST_CHECK_THROW(byindex.play(9), HSFCValueError);
+
+    // The view keeps the moves of the state it came from
+    BOOST_CHECK(view[4] == jms[4]);
+    BOOST_CHECK_EQUAL(byindex.jointMoves().size(), 8);
+}
+
+BOOST_AUTO_TEST_CASE(joint_arrays)
+{
+    Game game(g_tictactoe);
+    State state = game.initState();
+    Player xplayer = get_player(game, "xplayer");
+    Player oplayer = get_player(game, "oplayer");
+
+    // The array and map forms of a joint move convert to each other
+    JointMoves view = state.jointMoves();
+    JointMoveArray jma;
+    BOOST_CHECK_EQUAL(jma.size(), 0);
+    view.get(2, jma);
+    BOOST_CHECK(jma.complete());
+    BOOST_CHECK_EQUAL(jma.size(), 2);
+    BOOST_CHECK(jma.tomap() == view[2]);
+    BOOST_CHECK(JointMoveArray(view[2]) == jma);
+    BOOST_CHECK_EQUAL(hash_value(JointMoveArray(view[2])), hash_value(jma));
+    BOOST_CHECK(jma[oplayer] == view[2].at(oplayer));
+
+    // A move can be set one player at a time
+    JointMoveArray partial;
+    partial.set(jma[xplayer]);
+    BOOST_CHECK(!partial.complete());
+    BOOST_CHECK(partial[xplayer] == jma[xplayer]);
+    BOOST_CHECK_THROW(partial[oplayer], HSFCValueError);
+    BOOST_CHECK_THROW(state.play(partial), HSFCValueError);
+    partial.set(jma[oplayer]);
+    BOOST_CHECK(partial == jma);
+
+    // Playing the array is the same as playing the map
+    State byarray(state);
+    State bymap(state);
+    byarray.play(jma);
+    bymap.play(view[2]);
+    BOOST_CHECK(byarray.fluents() == bymap.fluents());
+    BOOST_CHECK_THROW(byarray.play(jma), HSFCValueError);
+
+    // The goals after a playout
+    JointGoalArray jga;
+    State terminal(state);
+    terminal.playout(jga);
+    BOOST_CHECK_EQUAL(jga.size(), 2);
+    BOOST_CHECK_EQUAL(jga[xplayer] + jga[oplayer], 100);
+    JointGoalArray fromstate;
+    terminal.goals(fromstate);
+    BOOST_CHECK(fromstate.tomap() == terminal.goals());
+    BOOST_CHECK(JointGoalArray(terminal.goals()).tomap() == jga.tomap());
+}
+
+BOOST_AUTO_TEST_CASE(fluent_text)
+{
+    Game game(g_tictactoe);
+    State state = game.initState();
+
+    // The cached text is the same whether streamed or returned
+    std::vector<Fluent> fluents = state.fluents();
+    BOOST_REQUIRE(!fluents.empty());
+    BOOST_FOREACH(const Fluent& f, fluents)
+    {
+        std::ostringstream ss;
+        ss << f;
+        BOOST_CHECK_EQUAL(ss.str(), f.tostring());
+        BOOST_CHECK(f.tostring().find("(true:") == 0);
+    }
+}
+
 
 // NOTE: WE CURRENTLY HAVE NO WAY OF PICKING A MOVE EXPLICITLY. SO THE BEST
 // THAT WE CAN DO IS TO PICK THE FIRST FOR EACH PLAYER AND THEN TEST THAT
@@ -436,6 +569,90 @@ BOOST_AUTO_TEST_CASE(state_transition)
     BOOST_CHECK_EQUAL(get_num_moves(state7, "oplayer"), 1);
 }
 
+/****************************************************************
+ * Copies share the internal state until one of them is changed
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(copy_on_write)
+{
+    Game game(g_tictactoe);
+    State state1(game);
+    std::vector<Fluent> fluents = state1.fluents();
+
+    State state2(state1);
+    BOOST_CHECK(&state1.internal() == &state2.internal());
+    State state3(game);
+    state3 = state2;
+    BOOST_CHECK(&state1.internal() == &state3.internal());
+
+    // Playing a copy leaves the others alone
+    state2.play(state2.joints()[0]);
+    BOOST_CHECK(&state1.internal() != &state2.internal());
+    BOOST_CHECK(&state1.internal() == &state3.internal());
+    BOOST_CHECK(state1.fluents() == fluents);
+    BOOST_CHECK(state2.fluents() != fluents);
+    BOOST_CHECK_EQUAL(state1.joints().size(), 9);
+    BOOST_CHECK_EQUAL(state2.joints().size(), 8);
+
+    // So does a playout
+    std::vector<PlayerGoal> goals;
+    state3.playout(goals);
+    BOOST_CHECK(state3.isTerminal());
+    BOOST_CHECK(!state1.isTerminal());
+    BOOST_CHECK(state1.fluents() == fluents);
+
+    // A state that is not shared is changed in place
+    const hsfcState* internal = &state2.internal();
+    state2.play(state2.joints()[0]);
+    BOOST_CHECK(&state2.internal() == internal);
+}
+
+/****************************************************************
+ * play() checks every move against the state; playUnchecked()
+ * trusts the caller
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(play_validation)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    std::vector<JointMove> jms = state.joints();
+    boost::unordered_map<Player, std::vector<Move> > legals = state.legals();
+    std::vector<Player> players = game.players();
+
+    // A player with a move that belongs to the other player
+    std::vector<PlayerMove> wrong;
+    wrong.push_back(PlayerMove(players[0], legals[players[1]][0]));
+    wrong.push_back(PlayerMove(players[1], legals[players[0]][0]));
+    BOOST_CHECK_THROW(state.play(wrong), HSFCValueError);
+
+    // Too many and too few moves
+    std::vector<PlayerMove> twice(jms[0].begin(), jms[0].end());
+    twice.push_back(*jms[0].begin());
+    BOOST_CHECK_THROW(state.play(twice), HSFCValueError);
+    std::vector<PlayerMove> once(jms[0].begin(), jms[0].end());
+    once.pop_back();
+    BOOST_CHECK_THROW(state.play(once), HSFCValueError);
+
+    // Neither gets as far as changing the state
+    BOOST_CHECK_EQUAL(state.joints().size(), 9);
+
+    State checked(state);
+    State unchecked(state);
+    checked.play(jms[0]);
+    unchecked.playUnchecked(jms[0]);
+    BOOST_CHECK(checked.fluents() == unchecked.fluents());
+    BOOST_CHECK_EQUAL(unchecked.joints().size(), 8);
+
+    // Nothing need have been asked of the state first
+    State fresh(game);
+    fresh.playUnchecked(jms[0]);
+    BOOST_CHECK(checked.fluents() == fresh.fluents());
+
+    // A move that was legal a round ago is not legal now
+    BOOST_CHECK_THROW(checked.play(jms[0]), HSFCValueError);
+}
+
 /****************************************************************
  * Related to the issue that calculating the legal moves does itself
  * modify the internal structure of a State, similarly testing
@@ -466,6 +683,231 @@ BOOST_AUTO_TEST_CASE(state_transition_from_playout)
 
 }
 
+/****************************************************************
+ * A seeded playout can be repeated exactly.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(seeded_playout)
+{
+    Game game(g_tictactoe);
+    State state1(game);
+    State state2(game);
+    std::vector<PlayerGoal> goals1;
+    std::vector<PlayerGoal> goals2;
+
+    state1.playout(goals1, 42);
+    state2.playout(goals2, 42);
+    BOOST_CHECK(goals1 == goals2);
+    BOOST_CHECK_EQUAL(state1.internal().Round, state2.internal().Round);
+
+    std::vector<Fluent> fluents1 = state1.fluents();
+    std::vector<Fluent> fluents2 = state2.fluents();
+    std::sort(fluents1.begin(), fluents1.end());
+    std::sort(fluents2.begin(), fluents2.end());
+    BOOST_CHECK(fluents1 == fluents2);
+}
+
+/****************************************************************
+ * Playouts with the moves chosen by a policy.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(policy_playout)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    Player xplayer = get_player(game, "xplayer");
+    std::vector<PlayerGoal> goals;
+
+    // Only one of xplayer's opening moves has any weight
+    hsfcWeightedPolicy weighted(1.0);
+    std::vector<PlayerMove> legals;
+    state.legals(std::back_inserter(legals));
+    BOOST_FOREACH(const PlayerMove& pm, legals)
+    {
+        if (pm.first != xplayer) continue;
+        weighted.SetWeight(pm.second.relationid(),
+                           pm.second.tostring() == "(mark 1 1)" ? 1.0 : 0.0);
+    }
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+        State tmpstate(state);
+        tmpstate.playout(goals, weighted);
+        bool found = false;
+        BOOST_FOREACH(const Fluent& f, tmpstate.fluents())
+        {
+            if (f.tostring().find("cell 1 1 x") != std::string::npos) found = true;
+        }
+        BOOST_CHECK(found);
+    }
+
+    // MAST learns from every playout; xplayer makes one of its opening
+    // moves in each of them
+    hsfcMASTPolicy mast(10.0, 50.0);
+    for (unsigned int i = 0; i < 20; ++i)
+    {
+        State tmpstate(state);
+        goals.clear();
+        tmpstate.playout(goals, mast);
+        BOOST_CHECK_EQUAL(goals.size(), 2);
+    }
+    unsigned int visits = 0;
+    BOOST_FOREACH(const PlayerMove& pm, legals)
+    {
+        if (pm.first != xplayer) continue;
+        visits += mast.NumVisits(pm.second.relationid());
+        BOOST_CHECK(mast.Average(pm.second.relationid()) >= 0);
+        BOOST_CHECK(mast.Average(pm.second.relationid()) <= 100);
+    }
+    BOOST_CHECK(visits >= 20);
+}
+
+/****************************************************************
+ * Recording the moves of a playout.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(playout_trajectory)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    std::vector<Player> players = game.players();
+    std::vector<PlayerGoal> goals;
+    std::vector<unsigned int> trajectory;
+
+    // Record a playout and then replay its moves with play()
+    State tmpstate(state);
+    tmpstate.playout(goals, trajectory);
+    BOOST_CHECK(trajectory.size() >= 5 * players.size());
+    BOOST_CHECK_EQUAL(trajectory.size() % players.size(), 0);
+
+    State replay(state);
+    for (unsigned int i = 0; i < trajectory.size(); i += players.size())
+    {
+        BOOST_CHECK(!replay.isTerminal());
+        std::vector<PlayerMove> legals;
+        replay.legals(std::back_inserter(legals));
+        JointMove jmove;
+        BOOST_FOREACH(const PlayerMove& pm, legals)
+        {
+            for (unsigned int j = 0; j < players.size(); ++j)
+            {
+                if (pm.first == players[j] && pm.second.relationid() == trajectory[i + j])
+                    jmove.insert(pm);
+            }
+        }
+        BOOST_CHECK_EQUAL(jmove.size(), players.size());
+        replay.play(jmove);
+    }
+    BOOST_CHECK(replay.isTerminal());
+    std::vector<PlayerGoal> replaygoals;
+    replay.goals(std::back_inserter(replaygoals));
+    std::sort(goals.begin(), goals.end());
+    std::sort(replaygoals.begin(), replaygoals.end());
+    BOOST_CHECK(goals == replaygoals);
+
+    // The buffer is reused by the next playout
+    goals.clear();
+    tmpstate = state;
+    hsfcMASTPolicy mast(10.0, 50.0);
+    tmpstate.playout(goals, trajectory, &mast);
+    BOOST_CHECK(trajectory.size() <= 9 * players.size());
+    BOOST_CHECK_EQUAL(trajectory.size() % players.size(), 0);
+}
+
+/****************************************************************
+ * The single player queries must agree with the all player ones,
+ * whether or not they are asked before the state is evaluated
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(single_player_queries)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    State lazy(game);
+    std::vector<Player> players = game.players();
+
+    while (!state.isTerminal())
+    {
+        // Only the rules for one player's moves are run on lazy
+        std::vector<Move> lazymoves;
+        lazy.legals(players[1], std::back_inserter(lazymoves));
+
+        boost::unordered_map<Player, std::vector<Move> > legals = state.legals();
+        BOOST_CHECK(lazymoves == legals[players[1]]);
+        BOOST_FOREACH(const Player& p, players)
+        {
+            State tmpstate(state);
+            std::vector<Move> moves;
+            tmpstate.legals(p, std::back_inserter(moves));
+            BOOST_CHECK(moves == legals[p]);
+        }
+        JointMove jmove;
+        BOOST_FOREACH(const Player& p, players)
+        {
+            jmove.insert(PlayerMove(p, legals[p][0]));
+        }
+        state.play(jmove);
+        lazy.play(jmove);
+    }
+
+    JointGoal goals = state.goals();
+    BOOST_FOREACH(const Player& p, players)
+    {
+        State tmpstate(state);
+        BOOST_CHECK_EQUAL(tmpstate.goal(p), goals[p]);
+        BOOST_CHECK_EQUAL(lazy.goal(p), goals[p]);
+    }
+    BOOST_CHECK(lazy.isTerminal());
+    BOOST_CHECK_THROW(State(game).goal(players[0]), HSFCValueError);
+}
+
+/****************************************************************
+ * Batched playouts over several threads. The state must be left
+ * alone and every playout must be accounted for in the breakdown
+ * by first joint move, which must share them out evenly.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(batched_playouts)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    std::vector<Player> players = game.players();
+
+    PlayoutResults results = state.playouts(200, 4, 7);
+    BOOST_CHECK(!state.isTerminal());
+    BOOST_CHECK_EQUAL(results.total().count(), 200);
+    BOOST_CHECK_EQUAL(results.moves().size(), state.joints().size());
+
+    // 200 playouts over the 9 first moves is 22 each and 2 left over
+    unsigned int count = 0;
+    typedef std::pair<JointMove, PlayoutStats> jms_t;
+    BOOST_FOREACH(const jms_t& jms, results.moves())
+    {
+        BOOST_CHECK(jms.second.count() == 22 || jms.second.count() == 23);
+        count += jms.second.count();
+    }
+    BOOST_CHECK_EQUAL(count, 200);
+
+    // Tictactoe lasts at least 5 rounds and the goals add up to 100
+    BOOST_CHECK(results.total().rounds() >= 5.0);
+    BOOST_CHECK_CLOSE(results.total().mean(players[0]) +
+                      results.total().mean(players[1]), 100.0, 0.001);
+
+    // The same seed and threads give the same playouts
+    PlayoutResults again = state.playouts(200, 4, 7);
+    for (unsigned int i = 0; i < results.moves().size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(results.moves()[i].second.count(),
+                          again.moves()[i].second.count());
+        BOOST_CHECK_EQUAL(results.moves()[i].second.mean(players[0]),
+                          again.moves()[i].second.mean(players[0]));
+    }
+    BOOST_CHECK_EQUAL(results.total().rounds(), again.total().rounds());
+
+    // Not allowed from a terminal state
+    state.playout();
+    BOOST_CHECK_THROW(state.playouts(10), HSFCValueError);
+}
+
 
 /*
  * Even though two joint moves are equivalent they can have different
@@ -304,6 +304,52 @@ BOOST_AUTO_TEST_CASE(send_moves_across_games)
     BOOST_CHECK(movenamest == movenames2);
 }
 
+/****************************************************************
+ * A PortableMove does not carry the text of the move, so a move
+ * restored into a game that has never printed it must still print
+ * the same as the original.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(portable_move_tostring)
+{
+    Game game1(g_tictactoe);
+    Game game2(g_tictactoe);
+    State state1(game1);
+    State state2(game2);
+    std::vector<PlayerMove> playermoves;
+    std::vector<PortableMove> pmoves1;
+    std::vector<PortableMove> pmoves2;
+
+    state1.legals(std::back_inserter(playermoves));
+    BOOST_FOREACH(const PlayerMove& pm, playermoves)
+    {
+        pmoves1.push_back(PortableMove(pm.second));
+    }
+
+    std::ostringstream oserialstream;
+    boost::archive::text_oarchive oa(oserialstream);
+    oa << pmoves1;
+    std::istringstream iserialstream(oserialstream.str());
+    boost::archive::text_iarchive ia(iserialstream);
+    ia >> pmoves2;
+    BOOST_CHECK_EQUAL(pmoves2.size(), playermoves.size());
+
+    for (unsigned int i = 0; i < pmoves2.size(); ++i)
+    {
+        Move move(game2, pmoves2[i]);
+        BOOST_CHECK_EQUAL(move.tostring(), playermoves[i].second.tostring());
+    }
+
+    // The restored moves are the moves of the other game
+    std::vector<PlayerMove> playermoves2;
+    state2.legals(std::back_inserter(playermoves2));
+    BOOST_CHECK_EQUAL(playermoves2.size(), pmoves2.size());
+    for (unsigned int i = 0; i < playermoves2.size() && i < pmoves2.size(); ++i)
+    {
+        BOOST_CHECK(Move(game2, pmoves2[i]) == playermoves2[i].second);
+    }
+}
+
 /****************************************************************
  * Testing that PlayerMoves are the same across 2 instances
  * of the same game.
@@ -576,6 +622,34 @@ BOOST_AUTO_TEST_CASE(generate_equiv_states)
     BOOST_CHECK(pstate1 == pstate2);
 }
 
+/****************************************************************
+ * States are evaluated lazily; it must not matter whether anything
+ * has asked for the legal moves before a state is made portable
+ * or restored.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(portable_lazy_state)
+{
+    Game game1(g_tictactoe);
+    State state1(game1);
+    State state2(game1);
+
+    std::vector<JointMove> jms = state2.joints();
+    BOOST_CHECK_EQUAL(jms.size(), 9);
+    PortableState pstate1(state1);
+    PortableState pstate2(state2);
+    BOOST_CHECK(pstate1 == pstate2);
+
+    // Play without asking for anything in between
+    State state3(game1, pstate1);
+    state3.play(jms[0]);
+    state2.play(jms[0]);
+    State state4(state3);
+    BOOST_CHECK(PortableState(state4) == PortableState(state2));
+    BOOST_CHECK_EQUAL(state4.joints().size(), 8);
+    BOOST_CHECK_EQUAL(state3.joints().size(), 8);
+}
+
 /****************************************************************
  * The GDL variables
  ****************************************************************/
@@ -0,0 +1,297 @@
+//#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE HSFCUCTSearch
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <hsfc/hsfc.h>
+#include <hsfc/uct.h>
+
+using namespace HSFC;
+
+// Declare the tictactoe gdl. Defined at the end of the file.
+extern const char* g_tictactoe;
+
+/****************************************************************
+ * General support functions
+ ****************************************************************/
+
+// Return the player
+Player get_player(const Game& game, const std::string& playername)
+{
+    std::vector<Player> players = game.players();
+    BOOST_FOREACH(const Player& p, players)
+    {
+        if (p.tostring() == playername) return p;
+    }
+    BOOST_CHECK(false);
+    throw std::string("To prevent clang compiler warning");
+}
+
+// Return the legal move for a player that matches the text
+Move get_move(const State& state, const Player& player, const std::string& move)
+{
+    typedef boost::unordered_map<Player, std::vector<Move> > pmvs_t;
+    pmvs_t pmvs = state.legals();
+    pmvs_t::const_iterator it = pmvs.find(player);
+    BOOST_CHECK(it != pmvs.end());
+    BOOST_FOREACH(const Move& m, it->second)
+    {
+        if (m.tostring() == move) return m;
+    }
+    BOOST_CHECK(false);
+    throw std::string("To prevent clang compiler warning");
+}
+
+// Play a tictactoe mark for xplayer or oplayer while the other does a noop
+void play_mark(State& state, const Player& player, const Player& other,
+               const std::string& move)
+{
+    JointMove jm;
+    jm.emplace(player, get_move(state, player, move));
+    jm.emplace(other, get_move(state, other, "noop"));
+    state.play(jm);
+}
+
+/****************************************************************
+ * Searching from the initial state with several threads. Every
+ * iteration must be counted and the visits to the moves of each
+ * player must add up to the iterations through the root.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(search_budget)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    UCTSearch uct(state, 3);
+
+    BOOST_CHECK_THROW(uct.best(), HSFCValueError);
+    BOOST_CHECK_THROW(uct.search(0, 0), HSFCValueError);
+
+    uct.search(1000);
+    BOOST_CHECK_EQUAL(uct.iterations(), 1000);
+    BOOST_CHECK(uct.size() > 1);
+
+    typedef boost::unordered_map<Player, std::vector<Move> > pmvs_t;
+    pmvs_t pmvs = state.legals();
+    BOOST_FOREACH(const pmvs_t::value_type& pm, pmvs)
+    {
+        unsigned int total = 0;
+        BOOST_FOREACH(const Move& m, pm.second)
+        {
+            total += uct.visits(pm.first, m);
+            BOOST_CHECK(uct.value(pm.first, m) >= 0 && uct.value(pm.first, m) <= 100);
+        }
+        BOOST_CHECK_EQUAL(total, 1000);
+    }
+
+    // A time budget also stops the search
+    uct.search(0, 0.05);
+    BOOST_CHECK(uct.iterations() > 1000);
+
+    // The best joint move is legal
+    JointMove best = uct.best();
+    BOOST_CHECK_EQUAL(best.size(), 2);
+    state.play(best);
+}
+
+/****************************************************************
+ * Xplayer has two in a row with the third square free so the
+ * search must find the winning move.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(search_finds_win)
+{
+    Game game(g_tictactoe);
+    Player x = get_player(game, "xplayer");
+    Player o = get_player(game, "oplayer");
+    State state(game);
+    play_mark(state, x, o, "(mark 1 1)");
+    play_mark(state, o, x, "(mark 2 1)");
+    play_mark(state, x, o, "(mark 1 2)");
+    play_mark(state, o, x, "(mark 2 2)");
+
+    UCTSearch uct(state, 2, 1.0, 3);
+    uct.search(2000);
+    BOOST_CHECK_EQUAL(uct.best(x).tostring(), "(mark 1 3)");
+    BOOST_CHECK_CLOSE(uct.value(x, get_move(state, x, "(mark 1 3)")), 100.0, 0.001);
+}
+
+/****************************************************************
+ * Moving the root on keeps the subtree of the played joint move
+ * and the root state follows the game.
+ ****************************************************************/
+
+BOOST_AUTO_TEST_CASE(tree_reuse)
+{
+    Game game(g_tictactoe);
+    State state(game);
+    UCTSearch uct(state);
+    uct.search(2000);
+
+    std::size_t size = uct.size();
+    JointMove best = uct.best();
+    uct.play(best);
+    state.play(best);
+    BOOST_CHECK(uct.iterations() > 0);
+    BOOST_CHECK(uct.size() < size);
+    BOOST_CHECK_EQUAL(uct.root().joints().size(), state.joints().size());
+
+    // Play the game out with the search
+    while (!uct.root().isTerminal())
+    {
+        uct.search(200);
+        uct.play(uct.best());
+    }
+    BOOST_CHECK_THROW(uct.search(10), HSFCValueError);
+}
+
+
+/****************************************************************
+ * The GDL variables
+ ****************************************************************/
+
+const char* g_tictactoe = " \n\
+;;;; RULES   \n\
+ \n\
+(role xplayer) \n\
+(role oplayer) \n\
+(init (cell 1 1 b)) \n\
+(init (cell 1 2 b)) \n\
+(init (cell 1 3 b)) \n\
+(init (cell 2 1 b)) \n\
+(init (cell 2 2 b)) \n\
+(init (cell 2 3 b)) \n\
+(init (cell 3 1 b)) \n\
+(init (cell 3 2 b)) \n\
+(init (cell 3 3 b)) \n\
+(init (control xplayer)) \n\
+(<= (next (cell ?m ?n x)) (does xplayer (mark ?m ?n)) (true (cell ?m ?n b))) \n\
+(<= (next (cell ?m ?n o)) (does oplayer (mark ?m ?n)) (true (cell ?m ?n b))) \n\
+(<= (next (cell ?m ?n ?w)) (true (cell ?m ?n ?w)) (distinct ?w b)) \n\
+(<= (next (cell ?m ?n b)) (does ?w (mark ?j ?k)) (true (cell ?m ?n b)) (distinct ?m ?j)) \n\
+(<= (next (cell ?m ?n b)) (does ?w (mark ?j ?k)) (true (cell ?m ?n b)) (distinct ?n ?k)) \n\
+(<= (next (control xplayer)) (true (control oplayer))) \n\
+(<= (next (control oplayer)) (true (control xplayer))) \n\
+(<= (row ?m ?x) (true (cell ?m 1 ?x)) (true (cell ?m 2 ?x)) (true (cell ?m 3 ?x))) \n\
+(<= (column ?n ?x) (true (cell 1 ?n ?x)) (true (cell 2 ?n ?x)) (true (cell 3 ?n ?x))) \n\
+(<= (diagonal ?x) (true (cell 1 1 ?x)) (true (cell 2 2 ?x)) (true (cell 3 3 ?x))) \n\
+(<= (diagonal ?x) (true (cell 1 3 ?x)) (true (cell 2 2 ?x)) (true (cell 3 1 ?x))) \n\
+(<= (line ?x) (row ?m ?x)) \n\
+(<= (line ?x) (column ?m ?x)) \n\
+(<= (line ?x) (diagonal ?x)) \n\
+(<= open (true (cell ?m ?n b))) \n\
+(<= (legal ?w (mark ?x ?y)) (true (cell ?x ?y b)) (true (control ?w))) \n\
+(<= (legal xplayer noop) (true (control oplayer))) \n\
+(<= (legal oplayer noop) (true (control xplayer))) \n\
+(<= (goal xplayer 100) (line x)) \n\
+(<= (goal xplayer 50) (not (line x)) (not (line o)) (not open)) \n\
+(<= (goal xplayer 0) (line o)) \n\
+(<= (goal oplayer 100) (line o)) \n\
+(<= (goal oplayer 50) (not (line x)) (not (line o)) (not open)) \n\
+(<= (goal oplayer 0) (line x)) \n\
+(<= terminal (line x)) \n\
+(<= terminal (line o)) \n\
+(<= terminal (not open)) \n\
+ \n\
+;;;; STRATS  \n\
+ \n\
+(strat does 0) \n\
+(strat goal 1) \n\
+(strat init 0) \n\
+(strat legal 0) \n\
+(strat next 0) \n\
+(strat role 0) \n\
+(strat terminal 1) \n\
+(strat true 0) \n\
+(strat cell 0) \n\
+(strat column 0) \n\
+(strat control 0) \n\
+(strat diagonal 0) \n\
+(strat line 0) \n\
+(strat open 0) \n\
+(strat row 0) \n\
+ \n\
+;;;; PATHS   \n\
+ \n\
+(arg does/2 0 oplayer/0) \n\
+(arg does/2 0 xplayer/0) \n\
+(arg does/2 1 mark/2 0 1/0) \n\
+(arg does/2 1 mark/2 0 2/0) \n\
+(arg does/2 1 mark/2 0 3/0) \n\
+(arg does/2 1 mark/2 1 1/0) \n\
+(arg does/2 1 mark/2 1 2/0) \n\
+(arg does/2 1 mark/2 1 3/0) \n\
+(arg does/2 1 noop/0) \n\
+(arg goal/2 0 oplayer/0) \n\
+(arg goal/2 0 xplayer/0) \n\
+(arg goal/2 1 0/0) \n\
+(arg goal/2 1 100/0) \n\
+(arg goal/2 1 50/0) \n\
+(arg init/1 0 cell/3 0 1/0) \n\
+(arg init/1 0 cell/3 0 2/0) \n\
+(arg init/1 0 cell/3 0 3/0) \n\
+(arg init/1 0 cell/3 1 1/0) \n\
+(arg init/1 0 cell/3 1 2/0) \n\
+(arg init/1 0 cell/3 1 3/0) \n\
+(arg init/1 0 cell/3 2 b/0) \n\
+(arg init/1 0 control/1 0 xplayer/0) \n\
+(arg legal/2 0 oplayer/0) \n\
+(arg legal/2 0 xplayer/0) \n\
+(arg legal/2 1 mark/2 0 1/0) \n\
+(arg legal/2 1 mark/2 0 2/0) \n\
+(arg legal/2 1 mark/2 0 3/0) \n\
+(arg legal/2 1 mark/2 1 1/0) \n\
+(arg legal/2 1 mark/2 1 2/0) \n\
+(arg legal/2 1 mark/2 1 3/0) \n\
+(arg legal/2 1 noop/0) \n\
+(arg next/1 0 cell/3 0 1/0) \n\
+(arg next/1 0 cell/3 0 2/0) \n\
+(arg next/1 0 cell/3 0 3/0) \n\
+(arg next/1 0 cell/3 1 1/0) \n\
+(arg next/1 0 cell/3 1 2/0) \n\
+(arg next/1 0 cell/3 1 3/0) \n\
+(arg next/1 0 cell/3 2 b/0) \n\
+(arg next/1 0 cell/3 2 o/0) \n\
+(arg next/1 0 cell/3 2 x/0) \n\
+(arg next/1 0 control/1 0 oplayer/0) \n\
+(arg next/1 0 control/1 0 xplayer/0) \n\
+(arg role/1 0 oplayer/0) \n\
+(arg role/1 0 xplayer/0) \n\
+(arg terminal/0) \n\
+(arg true/1 0 cell/3 0 1/0) \n\
+(arg true/1 0 cell/3 0 2/0) \n\
+(arg true/1 0 cell/3 0 3/0) \n\
+(arg true/1 0 cell/3 1 1/0) \n\
+(arg true/1 0 cell/3 1 2/0) \n\
+(arg true/1 0 cell/3 1 3/0) \n\
+(arg true/1 0 cell/3 2 b/0) \n\
+(arg true/1 0 cell/3 2 o/0) \n\
+(arg true/1 0 cell/3 2 x/0) \n\
+(arg true/1 0 control/1 0 oplayer/0) \n\
+(arg true/1 0 control/1 0 xplayer/0) \n\
+(arg column/2 0 1/0) \n\
+(arg column/2 0 2/0) \n\
+(arg column/2 0 3/0) \n\
+(arg column/2 1 b/0) \n\
+(arg column/2 1 o/0) \n\
+(arg column/2 1 x/0) \n\
+(arg diagonal/1 0 b/0) \n\
+(arg diagonal/1 0 o/0) \n\
+(arg diagonal/1 0 x/0) \n\
+(arg line/1 0 b/0) \n\
+(arg line/1 0 o/0) \n\
+(arg line/1 0 x/0) \n\
+(arg open/0) \n\
+(arg row/2 0 1/0) \n\
+(arg row/2 0 2/0) \n\
+(arg row/2 0 3/0) \n\
+(arg row/2 1 b/0) \n\
+(arg row/2 1 o/0) \n\
+(arg row/2 1 x/0) \n\
+";
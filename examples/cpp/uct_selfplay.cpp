@@ -0,0 +1,76 @@
+/***************************************************************************
+ * For a given game (GDL), play the game out with every player choosing
+ * its moves by a shared UCT search. The search is given a fixed amount of
+ * time per round and the tree is kept from one round to the next.
+ ****************************************************************************/
+
+#include <iostream>
+#include <exception>
+#include <boost/lexical_cast.hpp>
+#include <boost/exception/all.hpp>
+#include <hsfc/hsfc.h>
+#include <hsfc/uct.h>
+
+/***************************************************************************
+ * Run the game to termination
+ **************************************************************************/
+
+void run(const std::string& gdlfilename, double round_length, unsigned int threads)
+{
+    std::cerr << "Loading GDL: " << gdlfilename << std::endl;
+    HSFC::Game game(boost::filesystem::path(gdlfilename.c_str()));
+    HSFC::State state(game);
+    HSFC::UCTSearch uct(state, threads);
+    unsigned int roundnum = 1;
+    while (!uct.root().isTerminal())
+    {
+        unsigned int reused = uct.iterations();
+        uct.search(0, round_length);
+        HSFC::JointMove best = uct.best();
+        std::cout << "Round " << roundnum++ << ": " << uct.iterations() << " iterations ("
+                  << reused << " reused), " << uct.size() << " nodes. Playing: "
+                  << best << std::endl;
+        uct.play(best);
+    }
+    std::cout << "Goals: " << uct.root().goals() << std::endl;
+}
+
+/***************************************************************************
+ * Main
+ **************************************************************************/
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc != 3 && argc != 4)
+        {
+            std::cout << "usage: <gdlfilename> <play-clock> [<threads>]" << std::endl << std::endl;
+            std::cout << "Play a game out with a UCT search for every player, giving " << std::endl
+                      << "the search play-clock seconds (real time) per round." << std::endl;
+            exit(0);
+        }
+
+        std::string gdlfilename(argv[1]);
+        double round_length = boost::lexical_cast<double>(argv[2]);
+        unsigned int threads = argc == 4 ? boost::lexical_cast<unsigned int>(argv[3]) : 1;
+        run(gdlfilename, round_length, threads);
+        return 0;
+    }
+    catch(HSFC::HSFCException& e)
+    {
+        if( std::string const * mi=boost::get_error_info<HSFC::ErrorMsgInfo>(e) )
+            std::cerr << "Error: " << *mi << std::endl;
+        return 1;
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << "std::exception: " << e.what() << std::endl;
+        return 1;
+    }
+    catch(...)
+    {
+        std::cerr << "Unknown error" << std::endl;
+        return 2;
+    }
+}
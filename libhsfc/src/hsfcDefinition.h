@@ -27,6 +27,18 @@
 
 #define XMAX_GAME_ROUNDS 1000
 
+// Packed bitset for the relation exists flags
+#define EXISTS_WORD_BITS 64
+#define EXISTS_WORDS(Count) (((Count) + EXISTS_WORD_BITS - 1) / EXISTS_WORD_BITS)
+#define EXISTS_TEST(Bits, ID) ((((Bits)[(ID) / EXISTS_WORD_BITS]) >> ((ID) % EXISTS_WORD_BITS)) & 1ULL)
+#define EXISTS_SET(Bits, ID) ((Bits)[(ID) / EXISTS_WORD_BITS] |= (1ULL << ((ID) % EXISTS_WORD_BITS)))
+#define EXISTS_CLEAR(Bits, ID) ((Bits)[(ID) / EXISTS_WORD_BITS] &= ~(1ULL << ((ID) % EXISTS_WORD_BITS)))
+
+typedef unsigned long long hsfcExistsWord;
+
+// Each state is a single block aligned to the cache line
+#define ARENA_ALIGNMENT 64
+
 using namespace std;
 
 // hsfcIO
@@ -160,6 +172,66 @@ typedef struct hsfcCalculator {
 	unsigned int FixedSize;
 } hsfcCalculator;
 
+//=============================================================================
+// STRUCT: hsfcRuleContext
+//=============================================================================
+// Scratch written while a rule executes; the calculators share the rule's plan
+typedef struct hsfcRuleContext {
+	int* Cursor;
+	unsigned int* CursorFirst;
+	unsigned int* CursorLast;
+	hsfcBufferTerm* Variable;
+	hsfcCalculator ResultCalculator;
+	hsfcCalculator* InputCalculator;
+	hsfcCalculator* ConditionCalculator;
+	hsfcCalculator* PreConditionCalculator;
+	int Transactions;
+} hsfcRuleContext;
+
+//=============================================================================
+// STRUCT: hsfcStratumContext
+//=============================================================================
+typedef struct hsfcStratumContext {
+	unsigned int NumRules;
+	hsfcRuleContext* Rule;
+	unsigned int* DeltaFirst;
+	unsigned int* DeltaLast;
+} hsfcStratumContext;
+
+//=============================================================================
+// STRUCT: hsfcRandom
+//=============================================================================
+// xoshiro256** generator
+typedef struct hsfcRandom {
+	unsigned long long Word[4];
+} hsfcRandom;
+
+//=============================================================================
+// STRUCT: hsfcContext
+//=============================================================================
+// One per thread; any number of states can be advanced through one context
+typedef struct hsfcContext {
+	unsigned int NumStrata;
+	hsfcStratumContext* Stratum;
+	hsfcRandom Random;
+	// The move each role was last given by ChooseRandomMoves or ChoosePolicyMoves
+	vector<unsigned int> ChosenMove;
+	// Scratch for playouts driven by a policy
+	vector<double> MoveWeight;
+	vector< vector<unsigned int> > PlayedMove;
+	// Scratch state for PlayOuts; created on first use and kept until the context is freed
+	struct hsfcState* PlayOutState;
+} hsfcContext;
+
+//=============================================================================
+// STRUCT: hsfcGoalEntry
+//=============================================================================
+// The role and value of a (goal ...) relation ID
+typedef struct hsfcGoalEntry {
+	unsigned int RoleIndex;
+	int Value;
+} hsfcGoalEntry;
+
 //=============================================================================
 // STRUCT: hsfcLegalMove
 //=============================================================================
@@ -169,6 +241,17 @@ typedef struct hsfcLegalMove {
 	hsfcTuple Tuple;	
 } hsfcLegalMove;
 
+//=============================================================================
+// STRUCT: hsfcPlayOutStats
+//=============================================================================
+// Running totals over a batch of playouts; one entry per role
+typedef struct hsfcPlayOutStats {
+	unsigned int NumPlayOuts;
+	double NumRounds;
+	vector<double> GoalTotal;
+	vector<double> GoalSquareTotal;
+} hsfcPlayOutStats;
+
 //=============================================================================
 // ENUM: hsfcStratumType
 //=============================================================================
@@ -275,7 +358,17 @@ typedef struct hsfcState {
 	unsigned int* NumRelations;
 	unsigned int* MaxNumRelations;
 	unsigned int** RelationID;
-	bool** RelationExists;
+	hsfcExistsWord** RelationExists;
 	unsigned int** RelationIDSorted;
+	bool* RelationChanged;
+	bool* StratumValid;
+	unsigned int NumDirtyRelations;
+	unsigned int* DirtyRelation;
+	bool* RelationDirty;
+	bool* NextSwapped;
+	unsigned int* NumRoleLegals;
+	unsigned int** RoleLegalID;
+	char* Arena;
+	char* ArenaBlock;
 } hsfcState;
 
@@ -216,8 +216,8 @@ bool hsfcEngine::CreateGameState(hsfcState** GameState) {
 		// Set up the data storage and rigids
 		this->StateManager->InitialiseState(*GameState);
 
-		// Set the number of roles
-		this->NumRoles = (*GameState)->NumRelations[this->StateManager->RoleRelationIndex];
+		// Set the number of roles; only the first state writes it
+		if (this->NumRoles == 0) this->NumRoles = (*GameState)->NumRelations[this->StateManager->RoleRelationIndex];
 
 		return true;
 
@@ -288,11 +288,85 @@ void hsfcEngine::CopyGameState(hsfcState* Destination, hsfcState* Source) {
 
 }
 
+//-----------------------------------------------------------------------------
+// CreateContext
+//-----------------------------------------------------------------------------
+hsfcContext* hsfcEngine::CreateContext() {
+
+	try {
+
+		// Each thread advancing states needs its own context
+		return this->RulesEngine->CreateContext();
+
+	}
+	catch (int e) {
+
+		cout << "CreateContext::Exception " << e << endl;
+		return NULL;
+
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// FreeContext
+//-----------------------------------------------------------------------------
+void hsfcEngine::FreeContext(hsfcContext* Context) {
+
+	try {
+
+		// Free the memory
+		this->RulesEngine->FreeContext(Context);
+
+	}
+	catch (int e) {
+
+		cout << "FreeContext::Exception " << e << endl;
+
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// SeedRandom
+//-----------------------------------------------------------------------------
+void hsfcEngine::SeedRandom(unsigned int Seed) {
+
+	// Use the engine's own context
+	this->SeedRandom(Seed, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::SeedRandom(unsigned int Seed, hsfcContext* Context) {
+
+	try {
+
+		// Random moves made through the context follow from the seed
+		this->RulesEngine->SeedRandom(Context, Seed);
+
+	}
+	catch (int e) {
+
+		cout << "SeedRandom::Exception: " << e << endl;
+
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // GetLegalMoves
 //-----------------------------------------------------------------------------
 void hsfcEngine::GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMove> >& LegalMove) {
 
+	// Use the engine's own context
+	this->GetLegalMoves(GameState, LegalMove, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMove> >& LegalMove, hsfcContext* Context) {
+
 	try {
 
 		// Clear the legal moves
@@ -301,11 +375,11 @@ void hsfcEngine::GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMov
 		}
 
 		// Advance the state to create the terminal relation tuple
-		if (GameState->CurrentStep < 1) this->RulesEngine->AdvanceState(GameState, 1, false);
+		if (GameState->CurrentStep < 1) this->RulesEngine->AdvanceState(GameState, 1, false, Context);
 		if (this->RulesEngine->IsTerminal(GameState)) return;
 
 		// Advance the state to create the legal relation tuples
-		if (GameState->CurrentStep < 2) this->RulesEngine->AdvanceState(GameState, 2, false);
+		if (GameState->CurrentStep < 2) this->RulesEngine->AdvanceState(GameState, 2, false, Context);
 
 		// Get the moves
 		this->RulesEngine->GetLegalMoves(GameState, LegalMove);
@@ -319,15 +393,81 @@ void hsfcEngine::GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMov
 
 }
 
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::GetLegalMoves(hsfcState* GameState, unsigned int RoleIndex, vector<hsfcLegalMove>& LegalMove, hsfcContext* Context) {
+
+	try {
+
+		// Clear the legal moves
+		LegalMove.clear();
+
+		// Execute only the strata the terminal relation depends on
+		if (GameState->CurrentStep < 1) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
+		if (this->RulesEngine->IsTerminal(GameState)) return;
+
+		// Execute only the strata the legal relation depends on
+		if (GameState->CurrentStep < 2) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->LegalPlan, Context);
+
+		// Get the moves for just the one role
+		this->RulesEngine->GetLegalMoves(GameState, RoleIndex, LegalMove);
+
+	}
+	catch (int e) {
+
+		cout << "GetLegalMoves::Exception: " << e << endl;
+
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// IsLegalMove
+//-----------------------------------------------------------------------------
+bool hsfcEngine::IsLegalMove(hsfcState* GameState, hsfcLegalMove& Move, hsfcContext* Context) {
+
+	try {
+
+		// No move is legal in a terminal state
+		if (GameState->CurrentStep < 1) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
+		if (this->RulesEngine->IsTerminal(GameState)) return false;
+
+		// Execute only the strata the legal relation depends on
+		if (GameState->CurrentStep < 2) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->LegalPlan, Context);
+
+		// Look up the move rather than listing them all
+		if (Move.RoleIndex < 0) return false;
+		return this->StateManager->LegalExists(GameState, Move.RoleIndex, Move.Tuple.ID);
+
+	}
+	catch (int e) {
+
+		cout << "IsLegalMove::Exception: " << e << endl;
+		return false;
+
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // DoMove
 //-----------------------------------------------------------------------------
 void hsfcEngine::DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove) {
 
+	// Use the engine's own context
+	this->DoMove(GameState, DoesMove, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove, hsfcContext* Context) {
+
 	try {
 
 		// The game step must be exactly after legal move tuples are calculated
-		if (GameState->CurrentStep != 2) return;
+		if (GameState->CurrentStep != 2) {
+			this->Lexicon->IO->WriteToLog(0, false, "Error: State at wrong step in hsfcEngine::DoMove\n");
+			return;
+		}
 
 		// Place the legal move tuples in the database
 		for (unsigned int i = 0; i < DoesMove.size(); i++) {
@@ -335,10 +475,10 @@ void hsfcEngine::DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove) {
 		}
 
 		// Advance the state to calculate the next tuples
-		this->RulesEngine->AdvanceState(GameState, 4, false);
+		this->RulesEngine->AdvanceState(GameState, 4, false, Context);
 
 		// Advance the state to the next state
-		this->RulesEngine->AdvanceState(GameState, 0, false);
+		this->RulesEngine->AdvanceState(GameState, 0, false, Context);
 
 	}
 	catch (int e) {
@@ -354,10 +494,18 @@ void hsfcEngine::DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove) {
 //-----------------------------------------------------------------------------
 bool hsfcEngine::IsTerminal(hsfcState* GameState) {
 
+	// Use the engine's own context
+	return this->IsTerminal(GameState, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+bool hsfcEngine::IsTerminal(hsfcState* GameState, hsfcContext* Context) {
+
 	try {
 
-		// Advance the state to create the terminal relation tuple
-		if (GameState->CurrentStep < 1) this->RulesEngine->AdvanceState(GameState, 1, false);
+		// Execute only the strata the terminal relation depends on
+		if (GameState->CurrentStep < 1) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
 		return this->RulesEngine->IsTerminal(GameState);
 
 	}
@@ -375,25 +523,27 @@ bool hsfcEngine::IsTerminal(hsfcState* GameState) {
 //-----------------------------------------------------------------------------
 void hsfcEngine::GetGoalValues(hsfcState* GameState, vector<int>& GoalValue) {
 
-	int Value;
+	// Use the engine's own context
+	this->GetGoalValues(GameState, GoalValue, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::GetGoalValues(hsfcState* GameState, vector<int>& GoalValue, hsfcContext* Context) {
 
 	try {
 
 		// Clear the goal values
 		GoalValue.clear();
 
-		// Advance the state to create the terminal relation tuple
-		if (GameState->CurrentStep < 1) this->RulesEngine->AdvanceState(GameState, 1, false);
-		this->RulesEngine->AdvanceState(GameState, 5, false);
+		// Execute only the strata the terminal relation depends on
+		if (GameState->CurrentStep < 1) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
 
 		// Return if the game is not terminal
 		if (!this->RulesEngine->IsTerminal(GameState)) return;
 
-		// Go through all of the roles
-		for (unsigned int i = 0; i < GameState->NumRelations[this->StateManager->RoleRelationIndex]; i++) {
-			Value = this->RulesEngine->GoalValue(GameState, i);
-			GoalValue.push_back(Value);
-		}
+		// Get the goal values for all of the roles
+		this->RulesEngine->GoalValues(GameState, GoalValue, Context);
 
 	}
 	catch (int e) {
@@ -404,15 +554,76 @@ void hsfcEngine::GetGoalValues(hsfcState* GameState, vector<int>& GoalValue) {
 
 }
 
+//-----------------------------------------------------------------------------
+// GetGoalValue
+//-----------------------------------------------------------------------------
+int hsfcEngine::GetGoalValue(hsfcState* GameState, unsigned int RoleIndex, hsfcContext* Context) {
+
+	try {
+
+		// Only the goal rules and their dependencies are executed
+		// The state need not be terminal; the value can be used as a heuristic
+		return this->RulesEngine->GoalValue(GameState, RoleIndex, Context);
+
+	}
+	catch (int e) {
+
+		cout << "GetGoalValue::Exception: " << e << endl;
+		return 0;
+
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // PlayOut
 //-----------------------------------------------------------------------------
 void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue) {
 
-	int Value;
+	// Use the engine's own context
+	this->PlayOut(GameState, GoalValue, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue, unsigned int Seed, hsfcContext* Context) {
+
+	// Reseed so that the playout can be repeated
+	this->SeedRandom(Seed, Context);
+	this->PlayOut(GameState, GoalValue, Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcContext* Context) {
+
+	hsfcPolicy* Policy;
+
+	// Moves are chosen uniformly at random
+	Policy = NULL;
+	this->PlayOut(GameState, GoalValue, Policy, Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcPolicy* Policy, hsfcContext* Context) {
+
+	// Nothing is recorded
+	this->PlayOut(GameState, GoalValue, Policy, NULL, NULL, Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+// The does IDs of each round's joint move are appended to the trajectory in
+// role order; the trajectory is cleared first but keeps its capacity
+void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcPolicy* Policy, vector<unsigned int>* Trajectory, int* TerminalRound, hsfcContext* Context) {
 
 	try {
 
+		// Clear the trajectory so that a failed playout records nothing
+		if (Trajectory != NULL) Trajectory->clear();
+		if (TerminalRound != NULL) *TerminalRound = GameState->Round;
+
 		// Clear the goal values
 		GoalValue.clear();
 		for (unsigned int i = 0; i < GameState->NumRelations[this->StateManager->RoleRelationIndex]; i++) {
@@ -425,33 +636,51 @@ void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue) {
 			return;
 		}
 
-		// Advance the state to create the terminal relation tuple
-		if (GameState->CurrentStep < 1) this->RulesEngine->AdvanceState(GameState, 1, false);
+		// Only the strata that terminal, legal and next depend on are run each round
+		// The (sees ...) strata are never needed and the goal strata are run at the end
+		if (GameState->CurrentStep < 1) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
+
+		// Record the moves each role makes for the policy to learn from
+		if (Policy != NULL) {
+			Context->PlayedMove.resize(this->NumRoles);
+			for (unsigned int i = 0; i < this->NumRoles; i++) Context->PlayedMove[i].clear();
+		}
 
 		// Play until the game is terminal
 		while ((!this->RulesEngine->IsTerminal(GameState)) && (GameState->Round <= this->Parameters->MaxPlayoutRound)) {
 
-			// Advance to calculate all the legal moves
-			if (GameState->CurrentStep < 2) this->RulesEngine->AdvanceState(GameState, 2, false);
+			// Calculate all the legal moves
+			if (GameState->CurrentStep < 2) this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->LegalPlan, Context);
 
 			// Get the legal move tuples
-			this->RulesEngine->ChooseRandomMoves(GameState);
+			if (Policy == NULL) {
+				this->RulesEngine->ChooseRandomMoves(GameState, Context);
+			} else {
+				this->RulesEngine->ChoosePolicyMoves(GameState, Policy, Context);
+				for (unsigned int i = 0; i < this->NumRoles; i++) {
+					Context->PlayedMove[i].push_back(Context->ChosenMove[i]);
+				}
+			}
+			if (Trajectory != NULL) {
+				Trajectory->insert(Trajectory->end(), Context->ChosenMove.begin(), Context->ChosenMove.end());
+			}
 
-			// Advance to the next state
-			this->RulesEngine->AdvanceState(GameState, 0, false);
+			// Calculate the next relations and advance to the next state
+			this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->NextPlan, Context);
+			this->StateManager->NextState(GameState);
 			if (this->Parameters->LogDetail > 3) this->StateManager->PrintRelations(GameState, false);
 
-			// Advance to calculate terminal tuple
-			this->RulesEngine->AdvanceState(GameState, 1, false);
+			// Calculate the terminal tuple
+			this->RulesEngine->ExecutePlan(GameState, this->RulesEngine->TerminalPlan, Context);
 
 		}
 
-		// Go through all of the roles
-		GoalValue.clear();
-		for (unsigned int i = 0; i < GameState->NumRelations[this->StateManager->RoleRelationIndex]; i++) {
-			Value = this->RulesEngine->GoalValue(GameState, i);
-			GoalValue.push_back(Value);
-		}
+		// Get the goal values for all of the roles
+		this->RulesEngine->GoalValues(GameState, GoalValue, Context);
+
+		// Let the policy learn from the result
+		if (Policy != NULL) Policy->Update(Context->PlayedMove, GoalValue);
+		if (TerminalRound != NULL) *TerminalRound = GameState->Round;
 
 	}
 	catch (int e) {
@@ -462,6 +691,85 @@ void hsfcEngine::PlayOut(hsfcState* GameState, vector<int>& GoalValue) {
 
 }
 
+//-----------------------------------------------------------------------------
+// PlayOuts
+//-----------------------------------------------------------------------------
+void hsfcEngine::PlayOuts(hsfcState* GameState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats) {
+
+	// Use the engine's own context
+	this->PlayOuts(GameState, NumPlayOuts, Stats, this->RulesEngine->Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOuts(hsfcState* GameState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcContext* Context) {
+
+	// The context keeps a state to play out in, so repeated calls reuse it
+	if (Context->PlayOutState == NULL) {
+		if (!this->CreateGameState(&Context->PlayOutState)) return;
+	}
+
+	this->PlayOuts(GameState, Context->PlayOutState, NumPlayOuts, Stats, Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOuts(hsfcState* GameState, hsfcState* PlayOutState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcContext* Context) {
+
+	hsfcPolicy* Policy;
+
+	// Moves are chosen uniformly at random
+	Policy = NULL;
+	this->PlayOuts(GameState, PlayOutState, NumPlayOuts, Stats, Policy, Context);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcEngine::PlayOuts(hsfcState* GameState, hsfcState* PlayOutState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcPolicy* Policy, hsfcContext* Context) {
+
+	vector<int> GoalValue;
+	double Value;
+
+	try {
+
+		// Stats accumulate so that batches can be merged; size them on first use
+		if (Stats.GoalTotal.size() == 0) {
+			Stats.NumPlayOuts = 0;
+			Stats.NumRounds = 0;
+			Stats.GoalTotal.resize(this->NumRoles, 0);
+			Stats.GoalSquareTotal.resize(this->NumRoles, 0);
+		}
+
+		// Each playout starts from a copy so the game state is never changed
+		for (unsigned int i = 0; i < NumPlayOuts; i++) {
+
+			this->StateManager->FromState(PlayOutState, GameState);
+			this->PlayOut(PlayOutState, GoalValue, Policy, Context);
+			if (GoalValue.size() != this->NumRoles) {
+				this->Lexicon->IO->WriteToLog(0, false, "Error: No goal values in hsfcEngine::PlayOuts\n");
+				return;
+			}
+
+			// Accumulate the results
+			Stats.NumPlayOuts++;
+			Stats.NumRounds += PlayOutState->Round - GameState->Round;
+			for (unsigned int j = 0; j < this->NumRoles; j++) {
+				Value = GoalValue[j];
+				Stats.GoalTotal[j] += Value;
+				Stats.GoalSquareTotal[j] += Value * Value;
+			}
+
+		}
+
+	}
+	catch (int e) {
+
+		cout << "PlayOuts::Exception: " << e << endl;
+
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // Validate
 //-----------------------------------------------------------------------------
@@ -557,8 +865,8 @@ void hsfcEngine::Validate(string* GDLFileName, hsfcParameters& Parameters) {
 
 
 	// Choose some moves
-	this->RulesEngine->ChooseRandomMoves(GameState);
-	this->RulesEngine->AdvanceState(GameState, 4, true);
+	this->RulesEngine->ChooseRandomMoves(GameState, this->RulesEngine->Context);
+	this->RulesEngine->AdvanceState(GameState, 4, true, this->RulesEngine->Context);
 
 	vector<hsfcTuple> Fluent;
 	this->GetStateFluents(GameState, Fluent);
@@ -35,11 +35,30 @@ public:
 	void FreeGameState(hsfcState* GameState);
 	void SetInitialGameState(hsfcState* GameState);
 	void CopyGameState(hsfcState* Destination, hsfcState* Source);
+	hsfcContext* CreateContext();
+	void FreeContext(hsfcContext* Context);
+	void SeedRandom(unsigned int Seed);
+	void SeedRandom(unsigned int Seed, hsfcContext* Context);
 	void GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMove> >& LegalMove);
+	void GetLegalMoves(hsfcState* GameState, vector< vector<hsfcLegalMove> >& LegalMove, hsfcContext* Context);
+	void GetLegalMoves(hsfcState* GameState, unsigned int RoleIndex, vector<hsfcLegalMove>& LegalMove, hsfcContext* Context);
+	bool IsLegalMove(hsfcState* GameState, hsfcLegalMove& Move, hsfcContext* Context);
 	void DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove);
+	void DoMove(hsfcState* GameState, vector<hsfcLegalMove>& DoesMove, hsfcContext* Context);
 	bool IsTerminal(hsfcState* GameState);
+	bool IsTerminal(hsfcState* GameState, hsfcContext* Context);
 	void GetGoalValues(hsfcState* GameState, vector<int>& GoalValue);
+	void GetGoalValues(hsfcState* GameState, vector<int>& GoalValue, hsfcContext* Context);
+	int GetGoalValue(hsfcState* GameState, unsigned int RoleIndex, hsfcContext* Context);
 	void PlayOut(hsfcState* GameState, vector<int>& GoalValue);
+	void PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcContext* Context);
+	void PlayOut(hsfcState* GameState, vector<int>& GoalValue, unsigned int Seed, hsfcContext* Context);
+	void PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcPolicy* Policy, hsfcContext* Context);
+	void PlayOut(hsfcState* GameState, vector<int>& GoalValue, hsfcPolicy* Policy, vector<unsigned int>* Trajectory, int* TerminalRound, hsfcContext* Context);
+	void PlayOuts(hsfcState* GameState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats);
+	void PlayOuts(hsfcState* GameState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcContext* Context);
+	void PlayOuts(hsfcState* GameState, hsfcState* PlayOutState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcContext* Context);
+	void PlayOuts(hsfcState* GameState, hsfcState* PlayOutState, unsigned int NumPlayOuts, hsfcPlayOutStats& Stats, hsfcPolicy* Policy, hsfcContext* Context);
 	void Validate(string* GDLFileName, hsfcParameters& Parameters);
 	void GetMoveText(hsfcLegalMove& Move);
 	void GetMoveText(hsfcTuple& Move, string& Text);
@@ -0,0 +1,184 @@
+//=============================================================================
+// Project: High Speed Forward Chaining
+// Module: Policy
+// Authors: Michael Schofield UNSW
+//
+//=============================================================================
+#include "stdafx.h"
+#include "hsfcPolicy.h"
+
+//=============================================================================
+// CLASS: hsfcPolicy
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+hsfcPolicy::hsfcPolicy(void) {
+
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+hsfcPolicy::~hsfcPolicy(void) {
+
+}
+
+//-----------------------------------------------------------------------------
+// Update
+//-----------------------------------------------------------------------------
+void hsfcPolicy::Update(vector< vector<unsigned int> >& PlayedMove, vector<int>& GoalValue) {
+
+	// Fixed policies learn nothing from a playout
+
+}
+
+//=============================================================================
+// CLASS: hsfcWeightedPolicy
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+hsfcWeightedPolicy::hsfcWeightedPolicy(double DefaultWeight) {
+
+	this->DefaultWeight = DefaultWeight;
+
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+hsfcWeightedPolicy::~hsfcWeightedPolicy(void) {
+
+	this->Table.clear();
+
+}
+
+//-----------------------------------------------------------------------------
+// Weight
+//-----------------------------------------------------------------------------
+double hsfcWeightedPolicy::Weight(unsigned int RoleIndex, unsigned int RelationID) {
+
+	// The relation ID already includes the role
+	if (RelationID < this->Table.size()) return this->Table[RelationID];
+	return this->DefaultWeight;
+
+}
+
+//-----------------------------------------------------------------------------
+// SetWeight
+//-----------------------------------------------------------------------------
+void hsfcWeightedPolicy::SetWeight(unsigned int RelationID, double Weight) {
+
+	// The table grows to the largest relation ID given a weight
+	if (RelationID >= this->Table.size()) {
+		this->Table.resize(RelationID + 1, this->DefaultWeight);
+	}
+	this->Table[RelationID] = Weight;
+
+}
+
+//-----------------------------------------------------------------------------
+// Clear
+//-----------------------------------------------------------------------------
+void hsfcWeightedPolicy::Clear() {
+
+	this->Table.clear();
+
+}
+
+//=============================================================================
+// CLASS: hsfcMASTPolicy
+//=============================================================================
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+hsfcMASTPolicy::hsfcMASTPolicy(double Temperature, double InitialValue) {
+
+	this->Temperature = Temperature;
+	this->InitialValue = InitialValue;
+	this->InitialWeight = exp(InitialValue / Temperature);
+
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+hsfcMASTPolicy::~hsfcMASTPolicy(void) {
+
+	this->Clear();
+
+}
+
+//-----------------------------------------------------------------------------
+// Weight
+//-----------------------------------------------------------------------------
+double hsfcMASTPolicy::Weight(unsigned int RoleIndex, unsigned int RelationID) {
+
+	// The weights are kept up to date by Update
+	if (RelationID < this->Table.size()) return this->Table[RelationID];
+	return this->InitialWeight;
+
+}
+
+//-----------------------------------------------------------------------------
+// Update
+//-----------------------------------------------------------------------------
+void hsfcMASTPolicy::Update(vector< vector<unsigned int> >& PlayedMove, vector<int>& GoalValue) {
+
+	unsigned int RelationID;
+
+	// Credit every move a role made with that role's goal value
+	for (unsigned int i = 0; (i < PlayedMove.size()) && (i < GoalValue.size()); i++) {
+		for (unsigned int j = 0; j < PlayedMove[i].size(); j++) {
+
+			// Grow the tables to the largest relation ID played
+			RelationID = PlayedMove[i][j];
+			if (RelationID >= this->Table.size()) {
+				this->Total.resize(RelationID + 1, 0);
+				this->Visits.resize(RelationID + 1, 0);
+				this->Table.resize(RelationID + 1, this->InitialWeight);
+			}
+
+			this->Total[RelationID] += GoalValue[i];
+			this->Visits[RelationID]++;
+			this->Table[RelationID] = exp(this->Total[RelationID] / this->Visits[RelationID] / this->Temperature);
+
+		}
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// Average
+//-----------------------------------------------------------------------------
+double hsfcMASTPolicy::Average(unsigned int RelationID) {
+
+	if ((RelationID >= this->Visits.size()) || (this->Visits[RelationID] == 0)) return this->InitialValue;
+	return this->Total[RelationID] / this->Visits[RelationID];
+
+}
+
+//-----------------------------------------------------------------------------
+// NumVisits
+//-----------------------------------------------------------------------------
+unsigned int hsfcMASTPolicy::NumVisits(unsigned int RelationID) {
+
+	if (RelationID >= this->Visits.size()) return 0;
+	return this->Visits[RelationID];
+
+}
+
+//-----------------------------------------------------------------------------
+// Clear
+//-----------------------------------------------------------------------------
+void hsfcMASTPolicy::Clear() {
+
+	this->Total.clear();
+	this->Visits.clear();
+	this->Table.clear();
+
+}
@@ -0,0 +1,93 @@
+//=============================================================================
+// Project: High Speed Forward Chaining
+// Module: Policy
+// Authors: Michael Schofield UNSW
+//
+//=============================================================================
+#pragma once
+
+#include <stdio.h>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "hsfcDefinition.h"
+
+using namespace std;
+
+//=============================================================================
+// CLASS: hsfcPolicy
+//=============================================================================
+// Weighs the legal moves during a playout; each role makes a move with
+// probability in proportion to its weight. Moves are identified by their
+// legal relation ID, which is also the ID of the matching does relation.
+// A policy is not locked; a policy that learns needs one instance per thread.
+class hsfcPolicy {
+
+public:
+	hsfcPolicy(void);
+	virtual ~hsfcPolicy(void);
+
+	virtual double Weight(unsigned int RoleIndex, unsigned int RelationID) = 0;
+	virtual void Update(vector< vector<unsigned int> >& PlayedMove, vector<int>& GoalValue);
+
+protected:
+
+private:
+
+};
+
+//=============================================================================
+// CLASS: hsfcWeightedPolicy
+//=============================================================================
+// A fixed table of weights; moves not in the table have the default weight
+class hsfcWeightedPolicy : public hsfcPolicy {
+
+public:
+	hsfcWeightedPolicy(double DefaultWeight);
+	~hsfcWeightedPolicy(void);
+
+	double Weight(unsigned int RoleIndex, unsigned int RelationID);
+	void SetWeight(unsigned int RelationID, double Weight);
+	void Clear();
+
+protected:
+
+private:
+	double DefaultWeight;
+	vector<double> Table;
+
+};
+
+//=============================================================================
+// CLASS: hsfcMASTPolicy
+//=============================================================================
+// Move-Average Sampling: a move is weighted by exp(Average / Temperature),
+// where Average is the mean goal value of the role over every playout in
+// which the move was made. Moves never made have the initial value.
+class hsfcMASTPolicy : public hsfcPolicy {
+
+public:
+	hsfcMASTPolicy(double Temperature, double InitialValue);
+	~hsfcMASTPolicy(void);
+
+	double Weight(unsigned int RoleIndex, unsigned int RelationID);
+	void Update(vector< vector<unsigned int> >& PlayedMove, vector<int>& GoalValue);
+	double Average(unsigned int RelationID);
+	unsigned int NumVisits(unsigned int RelationID);
+	void Clear();
+
+protected:
+
+private:
+	double Temperature;
+	double InitialValue;
+	double InitialWeight;
+	vector<double> Total;
+	vector<unsigned int> Visits;
+	vector<double> Table;
+
+};
+
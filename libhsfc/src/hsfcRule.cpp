@@ -24,10 +24,10 @@ hsfcRule::hsfcRule(hsfcLexicon* Lexicon, hsfcStateManager* StateManager, hsfcDom
 	this->StateManager = StateManager;
 	this->DomainManager = DomainManager;
 
-	this->Cursor = NULL;
 	this->Variable = NULL;
 	this->ResultCalculator.Term = NULL;
 	this->Input = NULL;
+	this->InputDelta = NULL;
 	this->Condition = NULL;
 	this->PreCondition = NULL;
 	this->ConditionFunction = NULL;
@@ -74,6 +74,8 @@ void hsfcRule::Initialise(){
 	this->VariableSize = 0;
 	this->LookupSize = 0;
 	this->SelfReferenceCount = 0;
+	this->NumRecursiveInputs = 0;
+	this->RecursiveCondition = false;
 
 }
 
@@ -116,13 +118,14 @@ void hsfcRule::FromSchema(hsfcRuleSchema* RuleSchema, bool LowSpeed) {
 	if (this->NumInputs > 0) {
 		// Create and populate the the arrays
 		this->Input = new int[this->NumInputs];
-		this->Cursor = new int[this->NumInputs];
+		this->InputDelta = new int[this->NumInputs];
 		this->InputCalculator = new hsfcCalculator[this->NumInputs];
 		Index = 0;
 		// Link to the lists in the state
 		for (unsigned int i = 0; i < RuleSchema->RelationSchema.size(); i++) {
 			if (RuleSchema->RelationSchema[i]->Type == hsfcRuleInput) {
 				this->Input[Index] = RuleSchema->RelationSchema[i]->TermSchema[0].RelationIndex;
+				this->InputDelta[Index] = -1;
 				this->BuildCalculator(RuleSchema->RelationSchema[i], &this->InputCalculator[Index]);
 				// Load the variable source
 				for (unsigned int j = 0; j < RuleSchema->RelationSchema[i]->TermSchema.size(); j++) {
@@ -418,7 +421,7 @@ NextInput:;
 //-----------------------------------------------------------------------------
 // CreateLookupTable
 //-----------------------------------------------------------------------------
-void hsfcRule::CreateLookupTable() {
+void hsfcRule::CreateLookupTable(hsfcRuleContext* Context) {
 
 	vector<hsfcTuple> Term;
 	vector<hsfcRuleTerm> RuleTerm;
@@ -479,8 +482,8 @@ void hsfcRule::CreateLookupTable() {
 			this->Lexicon->IO->FormatToLog(3, true, "PreCondition %d   Size = 1\n", PreConditionIndex);
 
 			// Calculate the value; out of range returns false 
-			if (this->CalculateValue(this->PreConditionCalculator[PreConditionIndex])) {
-				this->PreConditionLookup[PreConditionIndex][0] = this->PreConditionCalculator[PreConditionIndex].Value.ID;
+			if (this->CalculateValue(Context->PreConditionCalculator[PreConditionIndex])) {
+				this->PreConditionLookup[PreConditionIndex][0] = Context->PreConditionCalculator[PreConditionIndex].Value.ID;
 			} else {
 				this->PreConditionLookup[PreConditionIndex][0] = UNDEFINED;
 			}
@@ -510,8 +513,8 @@ void hsfcRule::CreateLookupTable() {
 		this->Lexicon->IO->FormatToLog(3, true, "Result   Size = %u\n", this->ResultLookupSize);
 
 		// Calculate the value; out of range returns false 
-		if (this->CalculateValue(this->ResultCalculator)) {
-			this->ResultLookup[0] = this->ResultCalculator.Value.ID;
+		if (this->CalculateValue(Context->ResultCalculator)) {
+			this->ResultLookup[0] = Context->ResultCalculator.Value.ID;
 		} else {
 			this->ResultLookup[0] = UNDEFINED;
 		}
@@ -571,7 +574,7 @@ void hsfcRule::CreateLookupTable() {
 
 		// Reset the cursors
 		for (int i = 0; i < this->NumInputs; i++) {
-			this->Cursor[i] = 0;
+			Context->Cursor[i] = 0;
 		}
 
 		// Load all the permutations
@@ -579,17 +582,17 @@ void hsfcRule::CreateLookupTable() {
 		do {
 
 			// Clear each of the terms in the buffer
-			this->ClearVariables(Lowiii);
+			this->ClearVariables(Context, Lowiii);
 
 			// Process each if the inputs into the buffer
 			for (iii = Lowiii; iii <= InputIndex; iii++) {
 
 				// Construct the lookup index
 				if (iii == 0) {
-					LookupIndex[iii] = this->Cursor[iii];
+					LookupIndex[iii] = Context->Cursor[iii];
 					LookupValue[iii] = this->InputLookup[iii][LookupIndex[iii]];
 				} else {
-					LookupIndex[iii] = LookupValue[iii - 1] + (this->MaxInputLookup[iii-1] + 1) * this->Cursor[iii];
+					LookupIndex[iii] = LookupValue[iii - 1] + (this->MaxInputLookup[iii-1] + 1) * Context->Cursor[iii];
 					LookupValue[iii] = this->InputLookup[iii][LookupIndex[iii]];
 				}
 
@@ -597,7 +600,7 @@ void hsfcRule::CreateLookupTable() {
 				if ((iii < InputIndex) && (LookupValue[iii] == UNDEFINED)) break;
 
 				// Load the buffer 
-				if (this->LoadInput(iii)) {
+				if (this->LoadInput(Context, iii)) {
 					// Record the results in the lookup for the highest input only
 					if (iii == InputIndex) {
 						LookupValue[iii] = NextLookupValue[InputIndex];
@@ -615,7 +618,7 @@ void hsfcRule::CreateLookupTable() {
 
 			// Advance the inputs
 			if (iii > InputIndex) iii = InputIndex;
-		} while (this->AdvanceInput(&Lowiii, iii));
+		} while (this->AdvanceInput(Context, &Lowiii, iii));
 
 		// Print the reference table
 		if (this->Lexicon->IO->Parameters->LogDetail > 3) {
@@ -676,7 +679,7 @@ void hsfcRule::CreateLookupTable() {
 
 	// Reset the cursors
 	for (int i = 0; i < this->NumInputs; i++) {
-		this->Cursor[i] = 0;
+		Context->Cursor[i] = 0;
 	}
 
 	// Load all the permutations
@@ -684,17 +687,17 @@ void hsfcRule::CreateLookupTable() {
 	do {
 
 		// Clear each of the terms in the buffer
-		this->ClearVariables(Lowiii);
+		this->ClearVariables(Context, Lowiii);
 
 		// Process each if the inputs into the buffer
 		for (iii = Lowiii; iii < this->NumInputs; iii++) {
 
 			// Construct the lookup index
 			if (iii == 0) {
-				LookupIndex[iii] = this->Cursor[iii];
+				LookupIndex[iii] = Context->Cursor[iii];
 				LookupValue[iii] = this->InputLookup[iii][LookupIndex[iii]];
 			} else {
-				LookupIndex[iii] = LookupValue[iii - 1] + (this->MaxInputLookup[iii-1] + 1) * this->Cursor[iii];
+				LookupIndex[iii] = LookupValue[iii - 1] + (this->MaxInputLookup[iii-1] + 1) * Context->Cursor[iii];
 				LookupValue[iii] = this->InputLookup[iii][LookupIndex[iii]];
 			}
 
@@ -702,7 +705,7 @@ void hsfcRule::CreateLookupTable() {
 			if (LookupValue[iii] == -1) break;
 
 			// If the load fails then the lookup is -1
-			if (!this->LoadInput(iii)) {
+			if (!this->LoadInput(Context, iii)) {
 				LookupValue[iii] = UNDEFINED;
 				break;
 			}
@@ -729,23 +732,23 @@ void hsfcRule::CreateLookupTable() {
 				} else {
 					// Test the condition to see if its in the negative
 					if ((this->ConditionFunction[i] & hsfcFunctionNot) == hsfcFunctionNot) {
-						this->ConditionLookup[i][LookupIndex[iii]] = this->ConditionID(i);
+						this->ConditionLookup[i][LookupIndex[iii]] = this->ConditionID(Context, i);
 						// A value of -1 is an automatic pass
 					} else {
-						this->ConditionLookup[i][LookupIndex[iii]] = this->ConditionID(i);
+						this->ConditionLookup[i][LookupIndex[iii]] = this->ConditionID(Context, i);
 						if (this->ConditionLookup[i][LookupIndex[iii]] == UNDEFINED) PreviousFailed = true;
 					}
 				}
 			}
 
 			// Construct the result lookup
-			this->ResultLookup[LookupIndex[iii]] = this->ResultID();
+			this->ResultLookup[LookupIndex[iii]] = this->ResultID(Context);
 
 		}
 
 		// Advance the inputs
 		if (iii == this->NumInputs) iii = this->NumInputs - 1;
-	} while (this->AdvanceInput(&Lowiii, iii));
+	} while (this->AdvanceInput(Context, &Lowiii, iii));
 
 	// Print the condition tables
 	for (int i = 0; i < this->NumConditions; i++) {
@@ -782,10 +785,118 @@ void hsfcRule::CreateLookupTable() {
 
 }
 
+//-----------------------------------------------------------------------------
+// FindRecursiveInputs
+//-----------------------------------------------------------------------------
+void hsfcRule::FindRecursiveInputs(vector<int>& StratumOutput) {
+
+	// An input is recursive if its relation is calculated in the same stratum
+	this->NumRecursiveInputs = 0;
+	for (int i = 0; i < this->NumInputs; i++) {
+		this->InputDelta[i] = -1;
+		for (unsigned int j = 0; j < StratumOutput.size(); j++) {
+			if (this->Input[i] == StratumOutput[j]) {
+				this->InputDelta[i] = j;
+				this->NumRecursiveInputs++;
+				break;
+			}
+		}
+	}
+
+	// A recursive precondition or condition can change the outcome of old tuples
+	this->RecursiveCondition = false;
+	for (int i = 0; i < this->NumPreConditions; i++) {
+		if ((this->PreConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) continue;
+		for (unsigned int j = 0; j < StratumOutput.size(); j++) {
+			if (this->PreCondition[i] == StratumOutput[j]) this->RecursiveCondition = true;
+		}
+	}
+	for (int i = 0; i < this->NumConditions; i++) {
+		if ((this->ConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) continue;
+		for (unsigned int j = 0; j < StratumOutput.size(); j++) {
+			if (this->Condition[i] == StratumOutput[j]) this->RecursiveCondition = true;
+		}
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// CreateContext
+//-----------------------------------------------------------------------------
+void hsfcRule::CreateContext(hsfcRuleContext* Context) {
+
+	// The cursors and variable buffer
+	Context->Cursor = NULL;
+	Context->CursorFirst = NULL;
+	Context->CursorLast = NULL;
+	Context->Variable = NULL;
+	Context->InputCalculator = NULL;
+	Context->ConditionCalculator = NULL;
+	Context->PreConditionCalculator = NULL;
+	Context->Transactions = 0;
+
+	if (this->VariableSize > 0) {
+		Context->Variable = new hsfcBufferTerm[this->VariableSize];
+		memcpy(Context->Variable, this->Variable, this->VariableSize * sizeof(hsfcBufferTerm));
+	}
+
+	// Each calculator gets its own term buffer
+	this->CopyCalculator(this->ResultCalculator, Context->ResultCalculator);
+	if (this->NumInputs > 0) {
+		Context->Cursor = new int[this->NumInputs];
+		Context->CursorFirst = new unsigned int[this->NumInputs];
+		Context->CursorLast = new unsigned int[this->NumInputs];
+		Context->InputCalculator = new hsfcCalculator[this->NumInputs];
+		for (int i = 0; i < this->NumInputs; i++) {
+			this->CopyCalculator(this->InputCalculator[i], Context->InputCalculator[i]);
+		}
+		this->ResetInputRange(Context);
+	}
+	if (this->NumConditions > 0) {
+		Context->ConditionCalculator = new hsfcCalculator[this->NumConditions];
+		for (int i = 0; i < this->NumConditions; i++) {
+			this->CopyCalculator(this->ConditionCalculator[i], Context->ConditionCalculator[i]);
+		}
+	}
+	if (this->NumPreConditions > 0) {
+		Context->PreConditionCalculator = new hsfcCalculator[this->NumPreConditions];
+		for (int i = 0; i < this->NumPreConditions; i++) {
+			this->CopyCalculator(this->PreConditionCalculator[i], Context->PreConditionCalculator[i]);
+		}
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// FreeContext
+//-----------------------------------------------------------------------------
+void hsfcRule::FreeContext(hsfcRuleContext* Context) {
+
+	// Only the term buffers belong to the context
+	if (Context->Variable != NULL) delete[](Context->Variable);
+	delete[](Context->ResultCalculator.Term);
+	if (Context->Cursor != NULL) {
+		delete[](Context->Cursor);
+		delete[](Context->CursorFirst);
+		delete[](Context->CursorLast);
+		for (int i = 0; i < this->NumInputs; i++) delete[](Context->InputCalculator[i].Term);
+		delete[](Context->InputCalculator);
+	}
+	if (Context->ConditionCalculator != NULL) {
+		for (int i = 0; i < this->NumConditions; i++) delete[](Context->ConditionCalculator[i].Term);
+		delete[](Context->ConditionCalculator);
+	}
+	if (Context->PreConditionCalculator != NULL) {
+		for (int i = 0; i < this->NumPreConditions; i++) delete[](Context->PreConditionCalculator[i].Term);
+		delete[](Context->PreConditionCalculator);
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // Execute
 //-----------------------------------------------------------------------------
-int hsfcRule::Execute(hsfcState* State){
+int hsfcRule::Execute(hsfcState* State, hsfcRuleContext* Context){
 
 	int InputIndex;
 	bool LoadFailed;
@@ -795,13 +906,13 @@ int hsfcRule::Execute(hsfcState* State){
 	NewRelationCount = 0;
 
 	// Check the preconditions
-	if (!this->CheckPreConditions(State)) {
+	if (!this->CheckPreConditions(Context, State)) {
 		return NewRelationCount;
 	}
 
 	// This may be a fully ground rule with no inputs; so we do it at least once
 	// Initialise all of the input cursors; no inputs return true; empty input list return false
-	if (!this->InitialiseInput(State)) {
+	if (!this->InitialiseInput(Context, State)) {
 		return NewRelationCount;
 	}
 
@@ -810,16 +921,16 @@ int hsfcRule::Execute(hsfcState* State){
 	do {
 
 		// Load the buffer with a valid tuple and test if it is valid
-		this->ClearVariables(LowInputIndex);
+		this->ClearVariables(Context, LowInputIndex);
 		// Load each input in turn
 		LoadFailed = false;
 		for (InputIndex = LowInputIndex; InputIndex < this->NumInputs; InputIndex++) {
 
 			// Count the transactions performed
-			this->Transactions++;
+			Context->Transactions++;
 
 			// Load the buffer
-			if (!this->LoadInput(InputIndex, State)) {
+			if (!this->LoadInput(Context, InputIndex, State)) {
 				LoadFailed = true;
 				break;
 			}
@@ -833,20 +944,20 @@ int hsfcRule::Execute(hsfcState* State){
 		InputIndex = this->NumInputs - 1;
 
 		// Check the conditions
-		if (this->CheckConditions(State)) {
+		if (this->CheckConditions(Context, State)) {
 
 			// Count the transactions performed
-			this->Transactions++;
+			Context->Transactions++;
 
 			// Post the result to the state
-			if (this->PostResult(State)) NewRelationCount++;
+			if (this->PostResult(Context, State)) NewRelationCount++;
 
 			// Is the relation full
 			if (State->NumRelations[this->Result] == State->MaxNumRelations[this->Result]) break;
 		}
 
 	// Advance the inputs
-	} while (this->AdvanceInput(&LowInputIndex, InputIndex, State));
+	} while (this->AdvanceInput(Context, &LowInputIndex, InputIndex, State));
 
 	return NewRelationCount;
 
@@ -855,7 +966,7 @@ int hsfcRule::Execute(hsfcState* State){
 //-----------------------------------------------------------------------------
 // HighSpeedExecute
 //-----------------------------------------------------------------------------
-int hsfcRule::HighSpeedExecute(hsfcState* State){
+int hsfcRule::HighSpeedExecute(hsfcState* State, hsfcRuleContext* Context){
 
 	unsigned int Index;
 	unsigned int Lookup[MAX_NO_OF_INPUTS];
@@ -883,24 +994,24 @@ int hsfcRule::HighSpeedExecute(hsfcState* State){
 			if ((this->PreConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) {
 				if (ID == 0) return 0;
 			} else {
-				if ((ID != UNDEFINED) && (State->RelationExists[this->PreCondition[i]][ID])) return 0;
+				if ((ID != UNDEFINED) && (EXISTS_TEST(State->RelationExists[this->PreCondition[i]], ID))) return 0;
 			}
 		} else {
 			// Apply the condition
 			if ((this->PreConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) {
 				if (ID == UNDEFINED) return 0;
 			} else {
-				if ((ID == UNDEFINED) || (!State->RelationExists[this->PreCondition[i]][ID])) return 0;
+				if ((ID == UNDEFINED) || (!EXISTS_TEST(State->RelationExists[this->PreCondition[i]], ID))) return 0;
 			}
 		}
 	}
 
 	// Set up the cursors on the Input lists
 	for (int i = 0; i < this->NumInputs; i++) {
-		// Initialise each list
-		this->Cursor[i] = 0;
 		// If any lists are empty then exit
-		if (State->NumRelations[this->Input[i]] == 0) return 0;
+		if (Context->CursorFirst[i] >= this->InputEnd(Context, i, State)) return 0;
+		// Initialise each list
+		Context->Cursor[i] = Context->CursorFirst[i];
 	}
 	LowInputIndex = 0;
 
@@ -915,9 +1026,9 @@ int hsfcRule::HighSpeedExecute(hsfcState* State){
 		for (int i = LowInputIndex; i < this->NumInputs; i++) {
 			// Offset the index based on the current RelationID
 			if (i == 0) {
-				Index = State->RelationID[this->Input[i]][this->Cursor[i]];
+				Index = State->RelationID[this->Input[i]][Context->Cursor[i]];
 			} else {
-				Index = Lookup[i-1] + (this->MaxInputLookup[i-1] + 1) * State->RelationID[this->Input[i]][this->Cursor[i]];
+				Index = Lookup[i-1] + (this->MaxInputLookup[i-1] + 1) * State->RelationID[this->Input[i]][Context->Cursor[i]];
 			}
 			Lookup[i] = this->InputLookup[i][Index];
 			if (Lookup[i] == UNDEFINED) {
@@ -939,14 +1050,14 @@ int hsfcRule::HighSpeedExecute(hsfcState* State){
 				if ((this->ConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) {
 					if (ID == 0) goto NextCombination;
 				} else {
-					if ((ID != UNDEFINED) && (State->RelationExists[this->Condition[i]][ID])) goto NextCombination;
+					if ((ID != UNDEFINED) && (EXISTS_TEST(State->RelationExists[this->Condition[i]], ID))) goto NextCombination;
 				}
 			} else {
 				// Apply the condition
 				if ((this->ConditionFunction[i] & hsfcFunctionDistinct) == hsfcFunctionDistinct) {
 					if (ID == UNDEFINED) goto NextCombination;
 				} else {
-					if ((ID == UNDEFINED) || (!State->RelationExists[this->Condition[i]][ID])) goto NextCombination;
+					if ((ID == UNDEFINED) || (!EXISTS_TEST(State->RelationExists[this->Condition[i]], ID))) goto NextCombination;
 				}
 			}
 		}
@@ -966,12 +1077,12 @@ NextCombination:
 		for (LowInputIndex = InputNo; LowInputIndex >= 0; LowInputIndex--) {
 
 			// Is the cursor at the end of the list
-			if (this->Cursor[LowInputIndex] == State->NumRelations[this->Input[LowInputIndex]] - 1) {
+			if (Context->Cursor[LowInputIndex] + 1 >= (int)this->InputEnd(Context, LowInputIndex, State)) {
 				// Reset the cursor to the beginning and advance the next cursor
-				this->Cursor[LowInputIndex] = 0;
+				Context->Cursor[LowInputIndex] = Context->CursorFirst[LowInputIndex];
 			} else {
 				// Advance this cursor only
-				(this->Cursor[LowInputIndex])++;
+				(Context->Cursor[LowInputIndex])++;
 				break;
 			}
 		}
@@ -983,10 +1094,84 @@ NextCombination:
 
 }
 
+//-----------------------------------------------------------------------------
+// DeltaExecute
+//-----------------------------------------------------------------------------
+int hsfcRule::DeltaExecute(hsfcState* State, hsfcRuleContext* Context, bool LowSpeed, unsigned int* DeltaFirst, unsigned int* DeltaLast, bool FirstPass){
+
+	int NewRelationCount;
+	int DeltaIndex;
+
+	// Semi-naive evaluation of a rule in a recursive stratum
+	// DeltaFirst..DeltaLast is the range of each stratum output list added by the previous pass
+	// Only combinations using at least one of those tuples can produce anything new
+
+	NewRelationCount = 0;
+
+	// Without recursive inputs the rule only has new tuples to see on the first pass
+	// A recursive condition can change the outcome for old tuples so it is always done in full
+	if ((this->NumRecursiveInputs == 0) || this->RecursiveCondition) {
+		if (!FirstPass && !this->RecursiveCondition) return 0;
+		for (int i = 0; i < this->NumInputs; i++) {
+			if (this->InputDelta[i] != -1) Context->CursorLast[i] = DeltaLast[this->InputDelta[i]];
+		}
+		if (LowSpeed) {
+			NewRelationCount = this->Execute(State, Context);
+		} else {
+			NewRelationCount = this->HighSpeedExecute(State, Context);
+		}
+		this->ResetInputRange(Context);
+		return NewRelationCount;
+	}
+
+	// Take the delta of each recursive input in turn
+	for (int j = 0; j < this->NumInputs; j++) {
+
+		// Is there a delta for this input
+		if (this->InputDelta[j] == -1) continue;
+		if (DeltaFirst[this->InputDelta[j]] == DeltaLast[this->InputDelta[j]]) continue;
+
+		// Earlier recursive inputs see only the old tuples; later ones see everything
+		for (int i = 0; i < this->NumInputs; i++) {
+			DeltaIndex = this->InputDelta[i];
+			if (DeltaIndex == -1) continue;
+			if (i < j) {
+				Context->CursorFirst[i] = 0;
+				Context->CursorLast[i] = DeltaFirst[DeltaIndex];
+			}
+			if (i == j) {
+				Context->CursorFirst[i] = DeltaFirst[DeltaIndex];
+				Context->CursorLast[i] = DeltaLast[DeltaIndex];
+			}
+			if (i > j) {
+				Context->CursorFirst[i] = 0;
+				Context->CursorLast[i] = DeltaLast[DeltaIndex];
+			}
+		}
+
+		// Execute the rule over the delta
+		if (LowSpeed) {
+			NewRelationCount += this->Execute(State, Context);
+		} else {
+			NewRelationCount += this->HighSpeedExecute(State, Context);
+		}
+
+		// Is the relation full
+		if (State->NumRelations[this->Result] == State->MaxNumRelations[this->Result]) break;
+
+	}
+
+	// Restore the full range for normal execution
+	this->ResetInputRange(Context);
+
+	return NewRelationCount;
+
+}
+
 //-----------------------------------------------------------------------------
 // Test
 //-----------------------------------------------------------------------------
-int hsfcRule::Test(hsfcState* State){
+int hsfcRule::Test(hsfcState* State, hsfcRuleContext* Context){
 
 	int InputIndex;
 	bool LoadFailed;
@@ -995,34 +1180,34 @@ int hsfcRule::Test(hsfcState* State){
 	int NewRelationCount;
 
 	TestTransactions = 0;
-	this->Transactions = 0;
+	Context->Transactions = 0;
 	NewRelationCount = 0;
 
 	printf("\nPreconditions -------------------------------------------------\n");
 
 	// Check the preconditions
-	if (!this->CheckPreConditions(State)) {
-		for (int i = 0; i < this->Transactions; i++) {
-			printf("%u.%u\n", this->PreConditionCalculator[i].Value.Index, this->PreConditionCalculator[i].Value.ID);
+	if (!this->CheckPreConditions(Context, State)) {
+		for (int i = 0; i < Context->Transactions; i++) {
+			printf("%u.%u\n", Context->PreConditionCalculator[i].Value.Index, Context->PreConditionCalculator[i].Value.ID);
 		}
-		TestTransactions += this->Transactions;
-		this->Transactions = 0;
+		TestTransactions += Context->Transactions;
+		Context->Transactions = 0;
 		printf("Fail\n");
 		printf("\nTransactions = %d\n", TestTransactions);
 		printf("--------------------------------------------------------------\n");
 		return NewRelationCount;
 	}
 
-	for (int i = 0; i < this->Transactions; i++) {
-		printf("%u.%u\n", this->PreConditionCalculator[i].Value.Index, this->PreConditionCalculator[i].Value.ID);
+	for (int i = 0; i < Context->Transactions; i++) {
+		printf("%u.%u\n", Context->PreConditionCalculator[i].Value.Index, Context->PreConditionCalculator[i].Value.ID);
 	}
-	TestTransactions += this->Transactions;
-	this->Transactions = 0;
+	TestTransactions += Context->Transactions;
+	Context->Transactions = 0;
 	printf("\nExecution ----------------------------------------------------\n");
 
 	// This may be a fully ground rule with no inputs; so we do it at least once
 	// Initialise all of the input cursors; no inputs return true; empty input list return false
-	if (!this->InitialiseInput(State)) {
+	if (!this->InitialiseInput(Context, State)) {
 		printf("No Inputs\n");
 		printf("\nTransactions = %d\n", TestTransactions);
 		printf("--------------------------------------------------------------\n");
@@ -1034,31 +1219,31 @@ int hsfcRule::Test(hsfcState* State){
 	do {
 
 		// Load the buffer with a valid tuple and test if it is valid
-		this->ClearVariables(LowInputIndex);
+		this->ClearVariables(Context, LowInputIndex);
 		for (int i = 0; i < LowInputIndex; i++) {
-			printf("%u.%u\t", this->InputCalculator[i].Value.Index, this->InputCalculator[i].Value.ID);
+			printf("%u.%u\t", Context->InputCalculator[i].Value.Index, Context->InputCalculator[i].Value.ID);
 		}
-		this->Transactions = 0;
+		Context->Transactions = 0;
 
 		// Load each input in turn
 		LoadFailed = false;
 		for (InputIndex = LowInputIndex; InputIndex < this->NumInputs; InputIndex++) {
 
 			// Count the transactions performed
-			this->Transactions++;
+			Context->Transactions++;
 
 			// Load the buffer
-			if (!this->LoadInput(InputIndex, State)) {
-				printf("%u.%u\t", this->InputCalculator[InputIndex].Value.Index, this->InputCalculator[InputIndex].Value.ID);
+			if (!this->LoadInput(Context, InputIndex, State)) {
+				printf("%u.%u\t", Context->InputCalculator[InputIndex].Value.Index, Context->InputCalculator[InputIndex].Value.ID);
 				printf("Fail\n");
 				LoadFailed = true;
 				break;
 			}
-			printf("%u.%u\t", this->InputCalculator[InputIndex].Value.Index, this->InputCalculator[InputIndex].Value.ID);
+			printf("%u.%u\t", Context->InputCalculator[InputIndex].Value.Index, Context->InputCalculator[InputIndex].Value.ID);
 
 		}
-		TestTransactions += this->Transactions;
-		this->Transactions = 0;
+		TestTransactions += Context->Transactions;
+		Context->Transactions = 0;
 
 		// InputIndex points to the Input that needs to be inrecemtned 
 		// for the next permutation
@@ -1068,36 +1253,36 @@ int hsfcRule::Test(hsfcState* State){
 
 		printf("<>\t");
 		// Check the conditions
-		if (this->CheckConditions(State)) {
+		if (this->CheckConditions(Context, State)) {
 
-			for (int i = 0; i < this->Transactions; i++) {
-				printf("%u.%u\t", this->ConditionCalculator[i].Value.Index, this->ConditionCalculator[i].Value.ID);
+			for (int i = 0; i < Context->Transactions; i++) {
+				printf("%u.%u\t", Context->ConditionCalculator[i].Value.Index, Context->ConditionCalculator[i].Value.ID);
 			}
-			TestTransactions += this->Transactions;
-			this->Transactions = 0;
+			TestTransactions += Context->Transactions;
+			Context->Transactions = 0;
 
 			// Count the transactions performed
-			this->Transactions++;
+			Context->Transactions++;
 
 			// Post the result to the state
-			if (this->PostResult(State)) NewRelationCount++;
-			printf("==\t%u.%u\n", this->ResultCalculator.Value.Index, this->ResultCalculator.Value.ID);
-			TestTransactions += this->Transactions;
-			this->Transactions = 0;
+			if (this->PostResult(Context, State)) NewRelationCount++;
+			printf("==\t%u.%u\n", Context->ResultCalculator.Value.Index, Context->ResultCalculator.Value.ID);
+			TestTransactions += Context->Transactions;
+			Context->Transactions = 0;
 
 			// Is the relation full
 			if (State->NumRelations[this->Result] == State->MaxNumRelations[this->Result]) break;
 		} else {
-			for (int i = 0; i < this->Transactions; i++) {
-				printf("%u.%u\t", this->ConditionCalculator[i].Value.Index, this->ConditionCalculator[i].Value.ID);
+			for (int i = 0; i < Context->Transactions; i++) {
+				printf("%u.%u\t", Context->ConditionCalculator[i].Value.Index, Context->ConditionCalculator[i].Value.ID);
 			}
-			TestTransactions += this->Transactions;
-			this->Transactions = 0;
+			TestTransactions += Context->Transactions;
+			Context->Transactions = 0;
 			printf("Fail\n");
 		}
 
 	// Advance the inputs
-	} while (this->AdvanceInput(&LowInputIndex, InputIndex, State));
+	} while (this->AdvanceInput(Context, &LowInputIndex, InputIndex, State));
 
 	printf("\nTransactions = %d\n", TestTransactions);
 	printf("--------------------------------------------------------------\n");
@@ -1131,10 +1316,6 @@ void hsfcRule::Print(bool ResetVariables) {
 void hsfcRule::ClearRule() {
 
 	// Free the resources
-	if (this->Cursor != NULL) {
-		delete[](this->Cursor);
-		this->Cursor = NULL;
-	}
 	if (this->Variable != NULL) {
 		delete[](this->Variable);
 		this->Variable = NULL;
@@ -1156,6 +1337,8 @@ void hsfcRule::ClearRule() {
 	if (this->Input != NULL) {
 		delete[](this->Input);
 		this->Input = NULL;
+		delete[](this->InputDelta);
+		this->InputDelta = NULL;
 		for (int i = 0; i < this->NumInputs; i++) {
 			delete[](this->InputCalculator[i].Term);
 			delete[](this->InputCalculator[i].Link);
@@ -1565,13 +1748,13 @@ void hsfcRule::PrintCalculator(hsfcCalculator& Calculator, bool ResetVariables){
 //-----------------------------------------------------------------------------
 // ClearVariables
 //-----------------------------------------------------------------------------
-void hsfcRule::ClearVariables(int LowInputIndex) {
+void hsfcRule::ClearVariables(hsfcRuleContext* Context, int LowInputIndex) {
 
 	// Clear each of the Terms in the buffer
 	for (int i = 0; i < this->VariableSize; i++) {
-		if (this->Variable[i].InputIndex >= LowInputIndex) {
-			this->Variable[i].Index = UNDEFINED;
-			this->Variable[i].ID = UNDEFINED;
+		if (Context->Variable[i].InputIndex >= LowInputIndex) {
+			Context->Variable[i].Index = UNDEFINED;
+			Context->Variable[i].ID = UNDEFINED;
 		}
 	}
 
@@ -1580,15 +1763,15 @@ void hsfcRule::ClearVariables(int LowInputIndex) {
 //-----------------------------------------------------------------------------
 // InitialiseInput
 //-----------------------------------------------------------------------------
-bool hsfcRule::InitialiseInput(hsfcState* State){ 
+bool hsfcRule::InitialiseInput(hsfcRuleContext* Context, hsfcState* State){ 
 	
 	// Set up the cursors on the source lists
 	for (int i = 0; i < this->NumInputs; i++) {
 
 		// Initialise each list
-		this->Cursor[i] = 0;
+		Context->Cursor[i] = Context->CursorFirst[i];
 		// If any lists are empty then exit
-		if (State->NumRelations[this->Input[i]] == 0) {
+		if (Context->CursorFirst[i] >= this->InputEnd(Context, i, State)) {
 			return false;
 		}
 	}
@@ -1597,10 +1780,37 @@ bool hsfcRule::InitialiseInput(hsfcState* State){
 
 }
 
+//-----------------------------------------------------------------------------
+// InputEnd
+//-----------------------------------------------------------------------------
+unsigned int hsfcRule::InputEnd(hsfcRuleContext* Context, int InputIndex, hsfcState* State){ 
+
+	// An undefined upper bound follows the list as it grows
+	if (Context->CursorLast[InputIndex] < State->NumRelations[this->Input[InputIndex]]) {
+		return Context->CursorLast[InputIndex];
+	}
+
+	return State->NumRelations[this->Input[InputIndex]];
+
+}
+
+//-----------------------------------------------------------------------------
+// ResetInputRange
+//-----------------------------------------------------------------------------
+void hsfcRule::ResetInputRange(hsfcRuleContext* Context){ 
+
+	// Each cursor covers the whole list
+	for (int i = 0; i < this->NumInputs; i++) {
+		Context->CursorFirst[i] = 0;
+		Context->CursorLast[i] = UNDEFINED;
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // AdvanceInput
 //-----------------------------------------------------------------------------
-bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex, hsfcState* State){ 
+bool hsfcRule::AdvanceInput(hsfcRuleContext* Context, int* LowInputIndex, int InputIndex, hsfcState* State){ 
 	
 	int i;
 
@@ -1614,12 +1824,12 @@ bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex, hsfcState* State
 
 		*LowInputIndex = i;
 		// Is the cursor at the end of the list
-		if (this->Cursor[i] == State->NumRelations[this->Input[i]] - 1) {
+		if (Context->Cursor[i] + 1 >= (int)this->InputEnd(Context, i, State)) {
 			// Reset the cursor to the beginning and advance the next cursor
-			this->Cursor[i] = 0;
+			Context->Cursor[i] = Context->CursorFirst[i];
 		} else {
 			// Advance this cursor only
-			(this->Cursor[i])++;
+			(Context->Cursor[i])++;
 			break;
 		}
 	}
@@ -1634,7 +1844,7 @@ bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex, hsfcState* State
 }
 
 //--- Overload ----------------------------------------------------------------
-bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex){
+bool hsfcRule::AdvanceInput(hsfcRuleContext* Context, int* LowInputIndex, int InputIndex){
 
 	int i;
 
@@ -1648,12 +1858,12 @@ bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex){
 
 		*LowInputIndex = i;
 		// Is the cursor at the end of the list
-		if (this->Cursor[i] == (this->InputCount[i] - 1)) {
+		if (Context->Cursor[i] == (this->InputCount[i] - 1)) {
 			// Reset the cursor to the beginning and advance the next cursor
-			this->Cursor[i] = 0;
+			Context->Cursor[i] = 0;
 		} else {
 			// Advance this cursor only
-			(this->Cursor[i])++;
+			(Context->Cursor[i])++;
 			break;
 		}
 	}
@@ -1670,31 +1880,31 @@ bool hsfcRule::AdvanceInput(int* LowInputIndex, int InputIndex){
 //-----------------------------------------------------------------------------
 // LoadInput
 //-----------------------------------------------------------------------------
-bool hsfcRule::LoadInput(int InputIndex, hsfcState* State) { 
+bool hsfcRule::LoadInput(hsfcRuleContext* Context, int InputIndex, hsfcState* State) { 
 
 	unsigned int VariableIndex;
 	unsigned int TermIndex;
 
 	// Get the input value from the state
-	this->InputCalculator[InputIndex].Value.Index = this->Input[InputIndex];
-	this->InputCalculator[InputIndex].Value.ID = State->RelationID[this->Input[InputIndex]][this->Cursor[InputIndex]];
+	Context->InputCalculator[InputIndex].Value.Index = this->Input[InputIndex];
+	Context->InputCalculator[InputIndex].Value.ID = State->RelationID[this->Input[InputIndex]][Context->Cursor[InputIndex]];
 
 	// Calculate the terms in the input
-	if (!this->CalculateTerms(this->InputCalculator[InputIndex])) {
+	if (!this->CalculateTerms(Context->InputCalculator[InputIndex])) {
 		return false;
 	}
 	
 	// Check all of the variables in the buffer
-	for (unsigned int i = 0; i < this->InputCalculator[InputIndex].VariableSize; i++) {
-		TermIndex = this->InputCalculator[InputIndex].Variable[i].SourceIndex;
-		VariableIndex = this->InputCalculator[InputIndex].Variable[i].DestinationIndex;
+	for (unsigned int i = 0; i < Context->InputCalculator[InputIndex].VariableSize; i++) {
+		TermIndex = Context->InputCalculator[InputIndex].Variable[i].SourceIndex;
+		VariableIndex = Context->InputCalculator[InputIndex].Variable[i].DestinationIndex;
 		// Is the variable already loaded
-		if (this->Variable[VariableIndex].ID == UNDEFINED) {
-			this->Variable[VariableIndex].Index = this->InputCalculator[InputIndex].Term[TermIndex].Index;
-			this->Variable[VariableIndex].ID = this->InputCalculator[InputIndex].Term[TermIndex].ID;
+		if (Context->Variable[VariableIndex].ID == UNDEFINED) {
+			Context->Variable[VariableIndex].Index = Context->InputCalculator[InputIndex].Term[TermIndex].Index;
+			Context->Variable[VariableIndex].ID = Context->InputCalculator[InputIndex].Term[TermIndex].ID;
 		} else {
-			if (this->Variable[VariableIndex].Index != this->InputCalculator[InputIndex].Term[TermIndex].Index) return false;
-			if (this->Variable[VariableIndex].ID != this->InputCalculator[InputIndex].Term[TermIndex].ID) return false;
+			if (Context->Variable[VariableIndex].Index != Context->InputCalculator[InputIndex].Term[TermIndex].Index) return false;
+			if (Context->Variable[VariableIndex].ID != Context->InputCalculator[InputIndex].Term[TermIndex].ID) return false;
 		}
 	}
 
@@ -1703,31 +1913,31 @@ bool hsfcRule::LoadInput(int InputIndex, hsfcState* State) {
 }
 
 //--- Overload ----------------------------------------------------------------
-bool hsfcRule::LoadInput(int InputIndex) { 
+bool hsfcRule::LoadInput(hsfcRuleContext* Context, int InputIndex) { 
 
 	unsigned int VariableIndex;
 	unsigned int TermIndex;
 
 	// Get the input value from the state
-	this->InputCalculator[InputIndex].Value.Index = this->Input[InputIndex];
-	this->InputCalculator[InputIndex].Value.ID = this->Cursor[InputIndex];
+	Context->InputCalculator[InputIndex].Value.Index = this->Input[InputIndex];
+	Context->InputCalculator[InputIndex].Value.ID = Context->Cursor[InputIndex];
 
 	// Calculate the terms in the input
-	if (!this->CalculateTerms(this->InputCalculator[InputIndex])) {
+	if (!this->CalculateTerms(Context->InputCalculator[InputIndex])) {
 		return false;
 	}
 	
 	// Check all of the variables in the buffer
-	for (unsigned int i = 0; i < this->InputCalculator[InputIndex].VariableSize; i++) {
-		TermIndex = this->InputCalculator[InputIndex].Variable[i].SourceIndex;
-		VariableIndex = this->InputCalculator[InputIndex].Variable[i].DestinationIndex;
+	for (unsigned int i = 0; i < Context->InputCalculator[InputIndex].VariableSize; i++) {
+		TermIndex = Context->InputCalculator[InputIndex].Variable[i].SourceIndex;
+		VariableIndex = Context->InputCalculator[InputIndex].Variable[i].DestinationIndex;
 		// Is the variable already loaded
-		if (this->Variable[VariableIndex].ID == UNDEFINED) {
-			this->Variable[VariableIndex].Index = this->InputCalculator[InputIndex].Term[TermIndex].Index;
-			this->Variable[VariableIndex].ID = this->InputCalculator[InputIndex].Term[TermIndex].ID;
+		if (Context->Variable[VariableIndex].ID == UNDEFINED) {
+			Context->Variable[VariableIndex].Index = Context->InputCalculator[InputIndex].Term[TermIndex].Index;
+			Context->Variable[VariableIndex].ID = Context->InputCalculator[InputIndex].Term[TermIndex].ID;
 		} else {
-			if (this->Variable[VariableIndex].Index != this->InputCalculator[InputIndex].Term[TermIndex].Index) return false;
-			if (this->Variable[VariableIndex].ID != this->InputCalculator[InputIndex].Term[TermIndex].ID) return false;
+			if (Context->Variable[VariableIndex].Index != Context->InputCalculator[InputIndex].Term[TermIndex].Index) return false;
+			if (Context->Variable[VariableIndex].ID != Context->InputCalculator[InputIndex].Term[TermIndex].ID) return false;
 		}
 	}
 
@@ -1739,7 +1949,7 @@ bool hsfcRule::LoadInput(int InputIndex) {
 //-----------------------------------------------------------------------------
 // PreConditionID
 //-----------------------------------------------------------------------------
-unsigned int hsfcRule::PreConditionID(int Index){
+unsigned int hsfcRule::PreConditionID(hsfcRuleContext* Context, int Index){
 
 	bool Distinct;
 	bool Not;
@@ -1756,13 +1966,13 @@ unsigned int hsfcRule::PreConditionID(int Index){
 	Distinct = (this->PreConditionFunction[Index] & hsfcFunctionDistinct) == hsfcFunctionDistinct;
 
 	// Calculate the value; out of range returns false 
-	if (!this->CalculateValue(this->PreConditionCalculator[Index])) {
+	if (!this->CalculateValue(Context->PreConditionCalculator[Index])) {
 		return UNDEFINED;
 	}
 
 	// Is it a (distinct x y)
 	if (Distinct) {
-		Equal = ((this->PreConditionCalculator[Index].Term[1].Index == this->PreConditionCalculator[Index].Term[2].Index) && (this->PreConditionCalculator[Index].Term[1].ID == this->PreConditionCalculator[Index].Term[2].ID));
+		Equal = ((Context->PreConditionCalculator[Index].Term[1].Index == Context->PreConditionCalculator[Index].Term[2].Index) && (Context->PreConditionCalculator[Index].Term[1].ID == Context->PreConditionCalculator[Index].Term[2].ID));
 		if ((!Not) && (Equal)) {
 			return UNDEFINED;
 		}
@@ -1773,19 +1983,19 @@ unsigned int hsfcRule::PreConditionID(int Index){
 	}
 
 	// Do an integrity check
-	if (this->PreConditionCalculator[Index].Value.ID > this->DomainManager->Domain[this->PreConditionCalculator[Index].Value.Index].IDCount) {
+	if (Context->PreConditionCalculator[Index].Value.ID > this->DomainManager->Domain[Context->PreConditionCalculator[Index].Value.Index].IDCount) {
 		this->Lexicon->IO->WriteToLog(0, false, "Error: PreCondition out of range\n");
 		abort();
 	}
 
-	return this->PreConditionCalculator[Index].Value.ID;
+	return Context->PreConditionCalculator[Index].Value.ID;
 
 }
 
 //-----------------------------------------------------------------------------
 // CheckPreConditions
 //-----------------------------------------------------------------------------
-bool hsfcRule::CheckPreConditions(hsfcState* State) { 
+bool hsfcRule::CheckPreConditions(hsfcRuleContext* Context, hsfcState* State) { 
 	
 	hsfcTuple Term;
 	bool Distinct;
@@ -1796,7 +2006,7 @@ bool hsfcRule::CheckPreConditions(hsfcState* State) {
 	for (int i = 0; i < this->NumPreConditions; i++) {
 
 		// Count the transactions performed
-		this->Transactions++;
+		Context->Transactions++;
 
 		// Set the type of condition
 		Not = (this->PreConditionFunction[i] & hsfcFunctionNot) == hsfcFunctionNot;
@@ -1804,7 +2014,7 @@ bool hsfcRule::CheckPreConditions(hsfcState* State) {
 
 		// Get the ID of the condition
 		Term.Index = this->PreCondition[i];
-		Term.ID = this->PreConditionID(i);
+		Term.ID = this->PreConditionID(Context, i);
 		if ((!Not) && (Term.ID == UNDEFINED)) return false;
 
 		// Is it a (distinct x y); any negation is resolved in the call to PreConditionID
@@ -1830,7 +2040,7 @@ bool hsfcRule::CheckPreConditions(hsfcState* State) {
 //-----------------------------------------------------------------------------
 // ConditionID
 //-----------------------------------------------------------------------------
-unsigned int hsfcRule::ConditionID(int Index){
+unsigned int hsfcRule::ConditionID(hsfcRuleContext* Context, int Index){
 
 	unsigned int VariableIndex;
 	unsigned int TermIndex;
@@ -1849,22 +2059,22 @@ unsigned int hsfcRule::ConditionID(int Index){
 	Distinct = (this->ConditionFunction[Index] & hsfcFunctionDistinct) == hsfcFunctionDistinct;
 
 	// Load the variables into the calculator
-	for (unsigned int i = 0; i < this->ConditionCalculator[Index].VariableSize; i++) {
-		TermIndex = this->ConditionCalculator[Index].Variable[i].SourceIndex;
-		VariableIndex = this->ConditionCalculator[Index].Variable[i].DestinationIndex;
+	for (unsigned int i = 0; i < Context->ConditionCalculator[Index].VariableSize; i++) {
+		TermIndex = Context->ConditionCalculator[Index].Variable[i].SourceIndex;
+		VariableIndex = Context->ConditionCalculator[Index].Variable[i].DestinationIndex;
 		// Load the variable
-		this->ConditionCalculator[Index].Term[TermIndex].Index = this->Variable[VariableIndex].Index;
-		this->ConditionCalculator[Index].Term[TermIndex].ID = this->Variable[VariableIndex].ID;
+		Context->ConditionCalculator[Index].Term[TermIndex].Index = Context->Variable[VariableIndex].Index;
+		Context->ConditionCalculator[Index].Term[TermIndex].ID = Context->Variable[VariableIndex].ID;
 	}
 
 	// Calculate the value; out of range returns false 
-	if (!this->CalculateValue(this->ConditionCalculator[Index])) {
+	if (!this->CalculateValue(Context->ConditionCalculator[Index])) {
 		return UNDEFINED;
 	}
 
 	// Is it a (distinct x y)
 	if (Distinct) {
-		Equal = ((this->ConditionCalculator[Index].Term[1].Index == this->ConditionCalculator[Index].Term[2].Index) && (this->ConditionCalculator[Index].Term[1].ID == this->ConditionCalculator[Index].Term[2].ID));
+		Equal = ((Context->ConditionCalculator[Index].Term[1].Index == Context->ConditionCalculator[Index].Term[2].Index) && (Context->ConditionCalculator[Index].Term[1].ID == Context->ConditionCalculator[Index].Term[2].ID));
 		if ((!Not) && (Equal)) {
 			return UNDEFINED;
 		}
@@ -1875,19 +2085,19 @@ unsigned int hsfcRule::ConditionID(int Index){
 	}
 
 	// Do an integrity check
-	if (this->ConditionCalculator[Index].Value.ID > this->DomainManager->Domain[this->ConditionCalculator[Index].Value.Index].IDCount) {
+	if (Context->ConditionCalculator[Index].Value.ID > this->DomainManager->Domain[Context->ConditionCalculator[Index].Value.Index].IDCount) {
 		this->Lexicon->IO->WriteToLog(0, false, "Error: Condition out of range\n");
 		abort();
 	}
 
-	return this->ConditionCalculator[Index].Value.ID;
+	return Context->ConditionCalculator[Index].Value.ID;
 
 }
 
 //-----------------------------------------------------------------------------
 // CheckConditions
 //-----------------------------------------------------------------------------
-bool hsfcRule::CheckConditions(hsfcState* State) { 
+bool hsfcRule::CheckConditions(hsfcRuleContext* Context, hsfcState* State) { 
 	
 	hsfcTuple Term;
 	bool Distinct;
@@ -1898,7 +2108,7 @@ bool hsfcRule::CheckConditions(hsfcState* State) {
 	for (int i = 0; i < this->NumConditions; i++) {
 
 		// Count the transactions performed
-		this->Transactions++;
+		Context->Transactions++;
 
 		// Set the type of condition
 		Not = (this->ConditionFunction[i] & hsfcFunctionNot) == hsfcFunctionNot;
@@ -1906,7 +2116,7 @@ bool hsfcRule::CheckConditions(hsfcState* State) {
 
 		// Get the ID of the condition
 		Term.Index = this->Condition[i];
-		Term.ID = this->ConditionID(i);
+		Term.ID = this->ConditionID(Context, i);
 		if ((!Not) && (Term.ID == UNDEFINED)) return false;
 
 		// Is it a (distinct x y); any negation is resolved in the call to PreConditionID
@@ -1933,44 +2143,44 @@ bool hsfcRule::CheckConditions(hsfcState* State) {
 //-----------------------------------------------------------------------------
 // ResultID
 //-----------------------------------------------------------------------------
-unsigned int hsfcRule::ResultID(){
+unsigned int hsfcRule::ResultID(hsfcRuleContext* Context){
 
 	unsigned int VariableIndex;
 	unsigned int TermIndex;
 
 	// Load the variables into the calculator
-	for (unsigned int i = 0; i < this->ResultCalculator.VariableSize; i++) {
-		TermIndex = this->ResultCalculator.Variable[i].SourceIndex;
-		VariableIndex = this->ResultCalculator.Variable[i].DestinationIndex;
+	for (unsigned int i = 0; i < Context->ResultCalculator.VariableSize; i++) {
+		TermIndex = Context->ResultCalculator.Variable[i].SourceIndex;
+		VariableIndex = Context->ResultCalculator.Variable[i].DestinationIndex;
 		// Load the variable
-		this->ResultCalculator.Term[TermIndex].Index = this->Variable[VariableIndex].Index;
-		this->ResultCalculator.Term[TermIndex].ID = this->Variable[VariableIndex].ID;
+		Context->ResultCalculator.Term[TermIndex].Index = Context->Variable[VariableIndex].Index;
+		Context->ResultCalculator.Term[TermIndex].ID = Context->Variable[VariableIndex].ID;
 	}
 
 	// Calculate the value; out of range returns false 
-	if (!this->CalculateValue(this->ResultCalculator)) {
+	if (!this->CalculateValue(Context->ResultCalculator)) {
 		return UNDEFINED;
 	}
 	// Do an integrity check
-	if (this->ResultCalculator.Value.ID > this->DomainManager->Domain[this->ResultCalculator.Value.Index].IDCount) {
+	if (Context->ResultCalculator.Value.ID > this->DomainManager->Domain[Context->ResultCalculator.Value.Index].IDCount) {
 		this->Lexicon->IO->WriteToLog(0, false, "Error: Result out of range\n");
 		abort();
 	}
 
-	return this->ResultCalculator.Value.ID;
+	return Context->ResultCalculator.Value.ID;
 
 }
 
 //-----------------------------------------------------------------------------
 // PostResult
 //-----------------------------------------------------------------------------
-bool hsfcRule::PostResult(hsfcState* State) { 
+bool hsfcRule::PostResult(hsfcRuleContext* Context, hsfcState* State) { 
 	
 	hsfcTuple Term;
 
 	// Get the ID of the condition
 	Term.Index = this->Result;
-	Term.ID = this->ResultID();
+	Term.ID = this->ResultID(Context);
 	
 	// Check it is a valid result
 	if (Term.ID == UNDEFINED) {
@@ -1988,6 +2198,18 @@ bool hsfcRule::PostResult(hsfcState* State) {
 
 }
 
+//-----------------------------------------------------------------------------
+// CopyCalculator
+//-----------------------------------------------------------------------------
+void hsfcRule::CopyCalculator(hsfcCalculator& Source, hsfcCalculator& Destination) {
+
+	// Share the plan; the fixed terms are already in the source buffer
+	Destination = Source;
+	Destination.Term = new hsfcTuple[Source.TermSize];
+	memcpy(Destination.Term, Source.Term, Source.TermSize * sizeof(hsfcTuple));
+
+}
+
 
 //=============================================================================
 // CLASS: hsfcStratum
@@ -2036,6 +2258,7 @@ bool hsfcStratum::Create(hsfcStratumSchema* StratumSchema, bool LowSpeedOnly) {
 
 	hsfcRule* NewRule;
 	int RuleSRC;
+	unsigned int Index;
 
 	// Initialise count
 	RuleSRC = 0;
@@ -2056,6 +2279,21 @@ bool hsfcStratum::Create(hsfcStratumSchema* StratumSchema, bool LowSpeedOnly) {
 	this->SelfReferenceCount = StratumSchema->SelfReferenceCount;
 	this->MultiPass = ((this->SelfReferenceCount > 1) || (RuleSRC > 1));
 
+	// Find the relations calculated by this stratum
+	for (unsigned int i = 0; i < this->Rule.size(); i++) {
+		for (Index = 0; Index < this->Output.size(); Index++) {
+			if (this->Output[Index] == this->Rule[i]->Result) break;
+		}
+		if (Index == this->Output.size()) this->Output.push_back(this->Rule[i]->Result);
+	}
+
+	// Multipass strata are executed semi-naively
+	if (this->MultiPass) {
+		for (unsigned int i = 0; i < this->Rule.size(); i++) {
+			this->Rule[i]->FindRecursiveInputs(this->Output);
+		}
+	}
+
 	// Is this stratum rigid
 	this->IsRigid = (StratumSchema->Rigidity == hsfcRigidityFull);
 	this->Type = StratumSchema->Type;
@@ -2067,7 +2305,7 @@ bool hsfcStratum::Create(hsfcStratumSchema* StratumSchema, bool LowSpeedOnly) {
 //-----------------------------------------------------------------------------
 // CreateLookupTables
 //-----------------------------------------------------------------------------
-void hsfcStratum::CreateLookupTables() {
+void hsfcStratum::CreateLookupTables(hsfcStratumContext* Context) {
 
 	this->LookupSize = 0;
 
@@ -2084,7 +2322,7 @@ void hsfcStratum::CreateLookupTables() {
 			this->Lexicon->IO->WriteToLog(3, true, "        LowSpeedExecution\n");
 		} else {
 			this->Lexicon->IO->LogIndent = 10;
-			this->Rule[i]->CreateLookupTable();
+			this->Rule[i]->CreateLookupTable(&Context->Rule[i]);
 			this->Lexicon->IO->LogIndent = 2;
 		}
 
@@ -2095,13 +2333,84 @@ void hsfcStratum::CreateLookupTables() {
 
 }
 
+//-----------------------------------------------------------------------------
+// CreateContext
+//-----------------------------------------------------------------------------
+void hsfcStratum::CreateContext(hsfcStratumContext* Context) {
+
+	// One context for each rule
+	Context->NumRules = this->Rule.size();
+	Context->Rule = new hsfcRuleContext[Context->NumRules];
+	for (unsigned int i = 0; i < this->Rule.size(); i++) {
+		this->Rule[i]->CreateContext(&Context->Rule[i]);
+	}
+
+	// Multipass strata track the tuples added by each pass
+	Context->DeltaFirst = NULL;
+	Context->DeltaLast = NULL;
+	if (this->MultiPass) {
+		Context->DeltaFirst = new unsigned int[this->Output.size()];
+		Context->DeltaLast = new unsigned int[this->Output.size()];
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// FreeContext
+//-----------------------------------------------------------------------------
+void hsfcStratum::FreeContext(hsfcStratumContext* Context) {
+
+	// Free the resources
+	for (unsigned int i = 0; i < Context->NumRules; i++) {
+		this->Rule[i]->FreeContext(&Context->Rule[i]);
+	}
+	delete[](Context->Rule);
+	if (Context->DeltaFirst != NULL) {
+		delete[](Context->DeltaFirst);
+		delete[](Context->DeltaLast);
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // ExecuteRules
 //-----------------------------------------------------------------------------
-void hsfcStratum::ExecuteRules(hsfcState* State, bool LowSpeed) {
+void hsfcStratum::ExecuteRules(hsfcState* State, hsfcStratumContext* Context, bool LowSpeed) {
 
 	int NewRelationCount;
 	int RuleRelationCount;
+	bool FirstPass;
+
+	// Recursive strata only join against the tuples added by the previous pass
+	if (this->MultiPass) {
+
+		// Everything already in the lists is new to the first pass
+		for (unsigned int i = 0; i < this->Output.size(); i++) {
+			Context->DeltaFirst[i] = 0;
+			Context->DeltaLast[i] = State->NumRelations[this->Output[i]];
+		}
+
+		FirstPass = true;
+		do {
+
+			// Execute the rules against the delta
+			NewRelationCount = 0;
+			for (unsigned int i = 0; i < this->Rule.size(); i++) {
+				NewRelationCount += this->Rule[i]->DeltaExecute(State, &Context->Rule[i], (this->Rule[i]->LowSpeed || LowSpeed), Context->DeltaFirst, Context->DeltaLast, FirstPass);
+			}
+
+			// The tuples added by this pass are the next delta
+			for (unsigned int i = 0; i < this->Output.size(); i++) {
+				Context->DeltaFirst[i] = Context->DeltaLast[i];
+				Context->DeltaLast[i] = State->NumRelations[this->Output[i]];
+			}
+			FirstPass = false;
+
+		} while (NewRelationCount > 0);
+
+		return;
+
+	}
 
 	// Execute all the rules at least once
 	do {
@@ -2112,9 +2421,9 @@ void hsfcStratum::ExecuteRules(hsfcState* State, bool LowSpeed) {
 			// execute the rule at least once
 			do {
 				if ((this->Rule[i]->LowSpeed) || LowSpeed) {
-					RuleRelationCount = this->Rule[i]->Execute(State);
+					RuleRelationCount = this->Rule[i]->Execute(State, &Context->Rule[i]);
 				} else {
-					RuleRelationCount = this->Rule[i]->HighSpeedExecute(State);
+					RuleRelationCount = this->Rule[i]->HighSpeedExecute(State, &Context->Rule[i]);
 				}
 				NewRelationCount += RuleRelationCount;
 			} while ((this->Rule[i]->SelfReferenceCount > 1) && (RuleRelationCount > 0));
@@ -2127,7 +2436,7 @@ void hsfcStratum::ExecuteRules(hsfcState* State, bool LowSpeed) {
 //-----------------------------------------------------------------------------
 // TestRules
 //-----------------------------------------------------------------------------
-void hsfcStratum::TestRules(hsfcState* State) {
+void hsfcStratum::TestRules(hsfcState* State, hsfcStratumContext* Context) {
 
 	int NewRelationCount;
 	int RuleRelationCount;
@@ -2141,7 +2450,7 @@ void hsfcStratum::TestRules(hsfcState* State) {
 			this->Rule[i]->Print(true);
 			// execute the rule at least once
 			do {
-				RuleRelationCount = this->Rule[i]->Test(State);
+				RuleRelationCount = this->Rule[i]->Test(State, &Context->Rule[i]);
 				NewRelationCount += RuleRelationCount;
 			} while ((this->Rule[i]->SelfReferenceCount > 1) && (RuleRelationCount > 0));
 		}
@@ -2177,6 +2486,7 @@ void hsfcStratum::DeleteRules(){
 		delete this->Rule[i];
 	}
 	this->Rule.clear();
+	this->Output.clear();
 
 }
 
@@ -2194,6 +2504,8 @@ hsfcRulesEngine::hsfcRulesEngine(hsfcLexicon* Lexicon, hsfcStateManager* StateMa
 	this->Lexicon = Lexicon;
 	this->StateManager = StateManager;
 	this->DomainManager = DomainManager;
+	this->Context = NULL;
+	this->NumContexts = 0;
 
 }
 
@@ -2222,6 +2534,12 @@ void hsfcRulesEngine::Initialise(){
 	this->Step.clear();
 	this->LookupSize = 0;
 
+	// Clear the query plans
+	this->TerminalPlan.clear();
+	this->LegalPlan.clear();
+	this->GoalPlan.clear();
+	this->NextPlan.clear();
+
 }
 
 //-----------------------------------------------------------------------------
@@ -2230,6 +2548,7 @@ void hsfcRulesEngine::Initialise(){
 bool hsfcRulesEngine::Create(hsfcSchema* Schema, bool LowSpeedOnly) {
 
 	hsfcStratum* NewStratum;
+	vector<unsigned int> NextRelation;
 
 	this->Lexicon->IO->LogIndent = 2;
 	this->Lexicon->IO->WriteToLog(2, true, "Creating Engine ...\n");
@@ -2253,6 +2572,29 @@ bool hsfcRulesEngine::Create(hsfcSchema* Schema, bool LowSpeedOnly) {
 	this->Lexicon->IO->WriteToLog(2, true, "  Set Stratum Properties\n");
 	this->SetStratumProperties();
 
+	// Create the plans that answer a single query
+	this->StateManager->CreatePlan(this->StateManager->TerminalRelationIndex, this->TerminalPlan);
+	this->StateManager->CreatePlan(this->StateManager->LegalRelationIndex, this->LegalPlan);
+	this->StateManager->CreatePlan(this->StateManager->GoalRelationIndex, this->GoalPlan);
+
+	// Playouts never look at (sees ...); the next state needs only the (next ...) strata
+	NextRelation.clear();
+	for (unsigned int i = 0; i < this->StateManager->NoNextRelation; i++) {
+		NextRelation.push_back(this->StateManager->NextRelationIndex[i]);
+	}
+	this->StateManager->CreatePlan(NextRelation, this->NextPlan);
+
+	// Print the plans
+	if (this->Lexicon->IO->Parameters->LogDetail > 2) {
+		this->Lexicon->IO->FormatToLog(3, true, "    Terminal plan %d of %d strata\n", (int)this->TerminalPlan.size(), (int)this->Stratum.size());
+		this->Lexicon->IO->FormatToLog(3, true, "    Legal plan %d of %d strata\n", (int)this->LegalPlan.size(), (int)this->Stratum.size());
+		this->Lexicon->IO->FormatToLog(3, true, "    Goal plan %d of %d strata\n", (int)this->GoalPlan.size(), (int)this->Stratum.size());
+		this->Lexicon->IO->FormatToLog(3, true, "    Next plan %d of %d strata\n", (int)this->NextPlan.size(), (int)this->Stratum.size());
+	}
+
+	// The engine's own context for building and for single threaded use
+	this->Context = this->CreateContext();
+
 	// Calculate all of the rigid facts
 	this->Lexicon->IO->LogIndent = 2;
 	this->Lexicon->IO->WriteToLog(2, true, "  Calculate Rigids\n");
@@ -2277,6 +2619,67 @@ bool hsfcRulesEngine::Create(hsfcSchema* Schema, bool LowSpeedOnly) {
 
 }
 
+//-----------------------------------------------------------------------------
+// CreateContext
+//-----------------------------------------------------------------------------
+hsfcContext* hsfcRulesEngine::CreateContext() {
+
+	hsfcContext* NewContext;
+
+	// The rules are shared; each context has its own cursors and buffers
+	NewContext = new hsfcContext;
+	NewContext->NumStrata = this->Stratum.size();
+	NewContext->Stratum = new hsfcStratumContext[NewContext->NumStrata];
+	for (unsigned int i = 0; i < this->Stratum.size(); i++) {
+		this->Stratum[i]->CreateContext(&NewContext->Stratum[i]);
+	}
+
+	NewContext->PlayOutState = NULL;
+
+	// Each context gets a different, but repeatable, random sequence
+	this->SeedRandom(NewContext, this->NumContexts);
+	this->NumContexts++;
+
+	return NewContext;
+
+}
+
+//-----------------------------------------------------------------------------
+// FreeContext
+//-----------------------------------------------------------------------------
+void hsfcRulesEngine::FreeContext(hsfcContext* Context) {
+
+	// Must be called before the strata are deleted
+	for (unsigned int i = 0; i < Context->NumStrata; i++) {
+		this->Stratum[i]->FreeContext(&Context->Stratum[i]);
+	}
+	delete[](Context->Stratum);
+	if (Context->PlayOutState != NULL) {
+		this->StateManager->FreeState(Context->PlayOutState);
+		delete Context->PlayOutState;
+	}
+	delete Context;
+
+}
+
+//-----------------------------------------------------------------------------
+// SeedRandom
+//-----------------------------------------------------------------------------
+void hsfcRulesEngine::SeedRandom(hsfcContext* Context, unsigned long long Seed) {
+
+	unsigned long long Value;
+
+	// Spread the seed over the generator state with splitmix64
+	for (unsigned int i = 0; i < 4; i++) {
+		Seed += 0x9E3779B97F4A7C15ULL;
+		Value = Seed;
+		Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBULL;
+		Context->Random.Word[i] = Value ^ (Value >> 31);
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // SetInitialState
 //-----------------------------------------------------------------------------
@@ -2290,7 +2693,7 @@ void hsfcRulesEngine::SetInitialState(hsfcState* State) {
 //-----------------------------------------------------------------------------
 // AdvanceState
 //-----------------------------------------------------------------------------
-void hsfcRulesEngine::AdvanceState(hsfcState* State, int Step, bool LowSpeed) {
+void hsfcRulesEngine::AdvanceState(hsfcState* State, int Step, bool LowSpeed, hsfcContext* Context) {
 
 	int NextStep;
 	int NoSteps;
@@ -2304,7 +2707,7 @@ void hsfcRulesEngine::AdvanceState(hsfcState* State, int Step, bool LowSpeed) {
 
 	// Is it the goal relations
 	if (Step == 5) {
-		this->ProcessRules(State, 5, LowSpeed, false);
+		this->ProcessRules(State, 5, LowSpeed, false, Context);
 		return;
 	}
 
@@ -2323,7 +2726,7 @@ void hsfcRulesEngine::AdvanceState(hsfcState* State, int Step, bool LowSpeed) {
 		if (NextStep == 0) {
 			this->StateManager->NextState(State);
 		} else {
-			this->ProcessRules(State, NextStep, LowSpeed, false);
+			this->ProcessRules(State, NextStep, LowSpeed, false, Context);
 		}
 
 		// Update the current step
@@ -2333,6 +2736,24 @@ void hsfcRulesEngine::AdvanceState(hsfcState* State, int Step, bool LowSpeed) {
 
 }
 
+//-----------------------------------------------------------------------------
+// ExecutePlan
+//-----------------------------------------------------------------------------
+void hsfcRulesEngine::ExecutePlan(hsfcState* State, vector<unsigned int>& Plan, hsfcContext* Context) {
+
+	unsigned int Index;
+	bool ForceLowSpeed = this->Lexicon->IO->Parameters->LowSpeedOnly;
+
+	// The current step is unchanged; later steps skip the strata already executed
+	for (unsigned int i = 0; i < Plan.size(); i++) {
+		Index = Plan[i];
+		if (State->StratumValid[Index]) continue;
+		this->Stratum[Index]->ExecuteRules(State, &Context->Stratum[Index], ForceLowSpeed);
+		State->StratumValid[Index] = true;
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // IsTerminal
 //-----------------------------------------------------------------------------
@@ -2351,88 +2772,92 @@ bool hsfcRulesEngine::IsTerminal(hsfcState* State) {
 //-----------------------------------------------------------------------------
 // GoalValue
 //-----------------------------------------------------------------------------
-int hsfcRulesEngine::GoalValue(hsfcState* State, int RoleIndex) {
+int hsfcRulesEngine::GoalValue(hsfcState* State, int RoleIndex, hsfcContext* Context) {
 
 	int Result;
-	hsfcTuple Term[3];
-	int Value;
-	hsfcTuple Tuple;
-	int RelationRoleIndex;
-	unsigned int NumRoles;
+	hsfcGoalEntry* Goal;
 	unsigned int NumRelations;
 
 	Result = 0;
 
-	// Assumes the states is at Step 1 or greater
-	// Execute the goal rules
-	if (State->CurrentStep != 5) this->ProcessRules(State, 5, false, false);
-
-	// Initialise 
-	NumRoles = this->DomainManager->Domain[this->StateManager->GoalRelationIndex].Size[0];
-	NumRelations = State->NumRelations[this->StateManager->GoalRelationIndex];
+	// Execute only the strata the goal rules depend on
+	this->ExecutePlan(State, this->GoalPlan, Context);
 
 	// Go through the Goal relations
+	NumRelations = State->NumRelations[this->StateManager->GoalRelationIndex];
 	for (unsigned int i = 0; i < NumRelations; i++) {
-		// Get the terms for the goal relation
-		Tuple.Index = this->StateManager->GoalRelationIndex;
-		Tuple.ID = State->RelationID[this->StateManager->GoalRelationIndex][i];
-		// Is it the correct role
-		RelationRoleIndex = this->StateManager->GoalToRole[Tuple.ID % NumRoles];
+		Goal = &this->StateManager->GoalTable[State->RelationID[this->StateManager->GoalRelationIndex][i]];
 		// Is this the right role
-		if (RelationRoleIndex == RoleIndex) {
-			this->DomainManager->IDToTerms(Tuple.Index, Term, Tuple.ID);
-			Value = atoi(this->Lexicon->Text(Term[2].ID));
-			if (Value > Result) Result = Value;
-		}
+		if ((Goal->RoleIndex == (unsigned int)RoleIndex) && (Goal->Value > Result)) Result = Goal->Value;
 	}
 		
 	return Result;
 
 }
 
+//-----------------------------------------------------------------------------
+// GoalValues
+//-----------------------------------------------------------------------------
+void hsfcRulesEngine::GoalValues(hsfcState* State, vector<int>& GoalValue, hsfcContext* Context) {
+
+	hsfcGoalEntry* Goal;
+	unsigned int NumRelations;
+
+	// Every role starts at zero
+	GoalValue.assign(this->StateManager->NumRoles, 0);
+
+	// Execute only the strata the goal rules depend on
+	this->ExecutePlan(State, this->GoalPlan, Context);
+
+	// One pass over the Goal relations gives the value for every role
+	NumRelations = State->NumRelations[this->StateManager->GoalRelationIndex];
+	for (unsigned int i = 0; i < NumRelations; i++) {
+		Goal = &this->StateManager->GoalTable[State->RelationID[this->StateManager->GoalRelationIndex][i]];
+		if ((Goal->RoleIndex != UNDEFINED) && (Goal->Value > GoalValue[Goal->RoleIndex])) GoalValue[Goal->RoleIndex] = Goal->Value;
+	}
+
+}
+
 //-----------------------------------------------------------------------------
 // GetLegalMoves
 //-----------------------------------------------------------------------------
 void hsfcRulesEngine::GetLegalMoves(hsfcState* State, vector< vector<hsfcLegalMove> >& LegalMove) {
 
-	hsfcLegalMove NewLegalMove;
-	unsigned int RoleIndex;
 	unsigned int NumRoles;
-	unsigned int NumLegalRoles;
-	unsigned int NumMoves;
-	unsigned int RelationID;
 
 	// Assumes the states is at Step 2 and not terminal
 
-	// Get the number of arguments and roles
+	// Get the number of roles
 	NumRoles = this->DomainManager->Domain[this->StateManager->RoleRelationIndex].Size[0];
-	NumLegalRoles = this->DomainManager->Domain[this->StateManager->LegalRelationIndex].Size[0];
-	NumMoves = State->NumRelations[this->StateManager->LegalRelationIndex];
 
 	// Resize the vector
 	LegalMove.resize(NumRoles);
 
-	// Clear the legal moves
-	for (unsigned int i = 0; i < LegalMove.size(); i++) {
-		LegalMove[i].clear();
+	// The legal moves are already sorted according to role
+	for (unsigned int i = 0; i < NumRoles; i++) {
+		this->GetLegalMoves(State, i, LegalMove[i]);
 	}
 
-	// Go through all of the legal moves
-	for (unsigned int i = 0; i < NumMoves; i++) {
+}
 
-		// Who is the move for
-		RelationID = State->RelationID[this->StateManager->LegalRelationIndex][i];
-		RoleIndex = this->StateManager->LegalToRole[RelationID % NumLegalRoles];
-		// Sort the move according to role
-		if (RoleIndex != UNDEFINED) {
-			// Create the new legal move
-			NewLegalMove.RoleIndex = RoleIndex;
-			NewLegalMove.Tuple.Index = this->StateManager->DoesRelationIndex;
-			NewLegalMove.Tuple.ID = RelationID;
-			NewLegalMove.Text = NULL;
-			LegalMove[RoleIndex].push_back(NewLegalMove);
-		}
+//--- Overload ----------------------------------------------------------------
+void hsfcRulesEngine::GetLegalMoves(hsfcState* State, unsigned int RoleIndex, vector<hsfcLegalMove>& LegalMove) {
+
+	hsfcLegalMove NewLegalMove;
+
+	// Assumes the states is at Step 2 and not terminal
+
+	// Clear the legal moves
+	LegalMove.clear();
 
+	// Go through the role's legal moves
+	for (unsigned int i = 0; i < State->NumRoleLegals[RoleIndex]; i++) {
+		// Create the new legal move
+		NewLegalMove.RoleIndex = RoleIndex;
+		NewLegalMove.Tuple.Index = this->StateManager->DoesRelationIndex;
+		NewLegalMove.Tuple.ID = State->RoleLegalID[RoleIndex][i];
+		NewLegalMove.Text = NULL;
+		LegalMove.push_back(NewLegalMove);
 	}
 
 }
@@ -2440,65 +2865,100 @@ void hsfcRulesEngine::GetLegalMoves(hsfcState* State, vector< vector<hsfcLegalMo
 //-----------------------------------------------------------------------------
 // ChooseRandomMoves
 //-----------------------------------------------------------------------------
-void hsfcRulesEngine::ChooseRandomMoves(hsfcState* State) {
+void hsfcRulesEngine::ChooseRandomMoves(hsfcState* State, hsfcContext* Context) {
 
-	vector<hsfcTuple> Move;
-	hsfcTuple NewMove;
-	int RandomNo;
-	int RandomIndex;
-	unsigned int RoleIndex;
-	vector<int> NumMoves;
+	hsfcTuple Move;
 	unsigned int NumRoles;
-	unsigned int NumLegalRoles;
-	unsigned int NumRelations;
-	unsigned int RelationID;
-
-	// Choose randomly
-	RandomNo = rand();
+	unsigned int NumMoves;
 
-	// Get the number of arguments and roles
+	// Get the number of roles
 	NumRoles = this->DomainManager->Domain[this->StateManager->RoleRelationIndex].Size[0];
-	NumLegalRoles = this->DomainManager->Domain[this->StateManager->LegalRelationIndex].Size[0];
-	NumRelations = State->NumRelations[this->StateManager->LegalRelationIndex];
+	Context->ChosenMove.resize(NumRoles);
 
-	// Go through all of the roles
+	// Choose a move for each role
 	for (unsigned int i = 0; i < NumRoles; i++) {
-		NumMoves.push_back(0);
-		NewMove.ID = 0;
-		NewMove.Index = this->StateManager->DoesRelationIndex;
-		Move.push_back(NewMove);
-	}
 
-	// Go through all of the legal moves
-	for (unsigned int i = 0; i < NumRelations; i++) {
+		Move.ID = 0;
+		Move.Index = this->StateManager->DoesRelationIndex;
 
-		// Who is the move for
-		RelationID = State->RelationID[this->StateManager->LegalRelationIndex][i];
-		RoleIndex = this->StateManager->LegalToRole[RelationID % NumLegalRoles];
-		if (RoleIndex != UNDEFINED) {
-			NumMoves[RoleIndex]++;
-			// Calculate the chance of this move being selected
-			RandomIndex = (RandomNo / (RoleIndex + 1)) % NumMoves[RoleIndex];
-			if (RandomIndex == 0) {
-				Move[RoleIndex].ID = RelationID;
-				Move[RoleIndex].Index = this->StateManager->DoesRelationIndex;
-			}
+		// Is there a move to make
+		NumMoves = State->NumRoleLegals[i];
+		if (NumMoves == 0) {
+			this->Lexicon->IO->FormatToLog(0, false, "Error: No moves for role %u\n", i);
+		} else {
+			Move.ID = State->RoleLegalID[i][this->RandomIndex(Context, NumMoves)];
 		}
+
+		// Make the chosen move
+		this->StateManager->AddRelation(State, Move);
+		Context->ChosenMove[i] = Move.ID;
+
 	}
 
+}
+
+//-----------------------------------------------------------------------------
+// ChoosePolicyMoves
+//-----------------------------------------------------------------------------
+void hsfcRulesEngine::ChoosePolicyMoves(hsfcState* State, hsfcPolicy* Policy, hsfcContext* Context) {
+
+	hsfcTuple Move;
+	unsigned int NumRoles;
+	unsigned int NumMoves;
+	unsigned int* RelationID;
+	double Weight;
+	double TotalWeight;
+	double Target;
+
+	// Get the number of roles
+	NumRoles = this->DomainManager->Domain[this->StateManager->RoleRelationIndex].Size[0];
+	Context->ChosenMove.resize(NumRoles);
+
 	// Choose a move for each role
 	for (unsigned int i = 0; i < NumRoles; i++) {
+
+		Move.ID = 0;
+		Move.Index = this->StateManager->DoesRelationIndex;
+
 		// Is there a move to make
-		if (NumMoves[i] == 0) {
+		NumMoves = State->NumRoleLegals[i];
+		RelationID = State->RoleLegalID[i];
+		if (NumMoves == 0) {
 			this->Lexicon->IO->FormatToLog(0, false, "Error: No moves for role %u\n", i);
+		} else {
+
+			// Weigh each legal move and total the weights
+			if (Context->MoveWeight.size() < NumMoves) Context->MoveWeight.resize(NumMoves);
+			TotalWeight = 0;
+			for (unsigned int j = 0; j < NumMoves; j++) {
+				Weight = Policy->Weight(i, RelationID[j]);
+				if (!(Weight > 0)) Weight = 0;
+				Context->MoveWeight[j] = Weight;
+				TotalWeight += Weight;
+			}
+
+			// Choose a point in the total weight; rounding can leave the point past
+			// the end so the last move with any weight is the fallback
+			// A role whose moves all have no weight chooses uniformly
+			if (TotalWeight > 0) {
+				Target = TotalWeight * this->RandomUnit(Context);
+				for (unsigned int j = 0; j < NumMoves; j++) {
+					if (Context->MoveWeight[j] == 0) continue;
+					Move.ID = RelationID[j];
+					Target -= Context->MoveWeight[j];
+					if (Target < 0) break;
+				}
+			} else {
+				Move.ID = RelationID[this->RandomIndex(Context, NumMoves)];
+			}
+
 		}
+
 		// Make the chosen move
-		this->StateManager->AddRelation(State, Move[i]);
-	}
+		this->StateManager->AddRelation(State, Move);
+		Context->ChosenMove[i] = Move.ID;
 
-	// Clear the moves;
-	Move.clear();
-	NumMoves.clear();
+	}
 
 }
 
@@ -2527,7 +2987,7 @@ void hsfcRulesEngine::Print() {
 //-----------------------------------------------------------------------------
 // ProcessRules
 //-----------------------------------------------------------------------------
-void hsfcRulesEngine::ProcessRules(hsfcState* State, int Step, bool LowSpeed, bool ProcessRigids) {
+void hsfcRulesEngine::ProcessRules(hsfcState* State, int Step, bool LowSpeed, bool ProcessRigids, hsfcContext* Context) {
 
 	// Step
 	// 1 = Terminal Rules 
@@ -2541,18 +3001,86 @@ void hsfcRulesEngine::ProcessRules(hsfcState* State, int Step, bool LowSpeed, bo
 	// Go through all of the rules
 	for (int i = this->FirstStratumIndex[Step]; i <= this->LastStratumIndex[Step]; i++) {
 		if (ProcessRigids || (!this->Stratum[i]->IsRigid)) {
-			this->Stratum[i]->ExecuteRules(State, ForceLowSpeed);
+			// Skip any stratum whose inputs have not changed since it was executed
+			if (State->StratumValid[i]) continue;
+			this->Stratum[i]->ExecuteRules(State, &Context->Stratum[i], ForceLowSpeed);
+			State->StratumValid[i] = true;
 		}
 	}
 	
 }
 
+//-----------------------------------------------------------------------------
+// NextRandom
+//-----------------------------------------------------------------------------
+unsigned long long hsfcRulesEngine::NextRandom(hsfcContext* Context) {
+
+	unsigned long long* Word;
+	unsigned long long Result;
+	unsigned long long Shifted;
+
+	// xoshiro256**
+	Word = Context->Random.Word;
+	Result = Word[1] * 5;
+	Result = ((Result << 7) | (Result >> 57)) * 9;
+	Shifted = Word[1] << 17;
+
+	Word[2] ^= Word[0];
+	Word[3] ^= Word[1];
+	Word[1] ^= Word[2];
+	Word[0] ^= Word[3];
+	Word[2] ^= Shifted;
+	Word[3] = (Word[3] << 45) | (Word[3] >> 19);
+
+	return Result;
+
+}
+
+//-----------------------------------------------------------------------------
+// RandomIndex
+//-----------------------------------------------------------------------------
+unsigned int hsfcRulesEngine::RandomIndex(hsfcContext* Context, unsigned int Range) {
+
+	unsigned long long Product;
+	unsigned int Low;
+	unsigned int Threshold;
+
+	// Multiply and shift rather than modulo; reject the few values
+	// that would make some indexes more likely than others
+	Product = (this->NextRandom(Context) >> 32) * Range;
+	Low = (unsigned int)Product;
+	if (Low < Range) {
+		Threshold = (0u - Range) % Range;
+		while (Low < Threshold) {
+			Product = (this->NextRandom(Context) >> 32) * Range;
+			Low = (unsigned int)Product;
+		}
+	}
+
+	return (unsigned int)(Product >> 32);
+
+}
+
+//-----------------------------------------------------------------------------
+// RandomUnit
+//-----------------------------------------------------------------------------
+double hsfcRulesEngine::RandomUnit(hsfcContext* Context) {
+
+	// The top 53 bits give every double in [0, 1) on an even spacing
+	return (this->NextRandom(Context) >> 11) * (1.0 / 9007199254740992.0);
+
+}
+
 //-----------------------------------------------------------------------------
 // DeleteStarata
 //-----------------------------------------------------------------------------
 void hsfcRulesEngine::DeleteStrata(){
 
 	// Free the resources
+	if (this->Context != NULL) {
+		this->FreeContext(this->Context);
+		this->Context = NULL;
+	}
 	for (unsigned int i = 0; i < this->Stratum.size(); i++) {
 		delete this->Stratum[i];
 	}
@@ -2646,7 +3174,7 @@ bool hsfcRulesEngine::CalculateRigids(){
 	for (unsigned int i = 0; i < this->Stratum.size(); i++) {
 		// Is this a rigid
 		if (this->Stratum[i]->IsRigid) {
-			this->Stratum[i]->ExecuteRules(this->State, true);
+			this->Stratum[i]->ExecuteRules(this->State, &this->Context->Stratum[i], true);
 		}
 	}
 
@@ -2698,23 +3226,23 @@ void hsfcRulesEngine::OptimiseRuleInputs() {
 
 		// Set the initial state
 		this->StateManager->SetInitialState(this->State);
-		this->AdvanceState(this->State, 1, true);
+		this->AdvanceState(this->State, 1, true, this->Context);
 		// Play until the game is terminal
 		while ((!this->IsTerminal(this->State)) && (clock() < Start + 3 * TICKS_PER_SECOND)) {
  
 			// Advance to calculate all the legal moves
-			this->AdvanceState(this->State, 2, true);
-			this->ChooseRandomMoves(this->State);
+			this->AdvanceState(this->State, 2, true, this->Context);
+			this->ChooseRandomMoves(this->State, this->Context);
 
 			// Record the statistics
-			this->AdvanceState(this->State, 4, true);
+			this->AdvanceState(this->State, 4, true, this->Context);
 			for (unsigned int i = 1; i < this->Schema->RelationSchema.size(); i++) {
 				this->Schema->RelationSchema[i]->Statistics.AddObservation((double)this->State->NumRelations[i]);
 			}
 			Count ++;
 
 			// Advance to the next state and calculate terminal tuple
-			this->AdvanceState(this->State, 1, true);
+			this->AdvanceState(this->State, 1, true, this->Context);
 		}
 	}
 
@@ -2741,7 +3269,7 @@ void hsfcRulesEngine::CreateLookupTables() {
 		this->Stratum[i]->LookupSize = 0;
 
 		this->Lexicon->IO->FormatToLog(3, true, "    Stratum %u\n", i);
-		this->Stratum[i]->CreateLookupTables();
+		this->Stratum[i]->CreateLookupTables(&this->Context->Stratum[i]);
 
 		// Calculate the lookup size
 		this->LookupSize += this->Stratum[i]->LookupSize;
@@ -13,6 +13,7 @@
 #include <time.h>
 
 #include "hsfcState.h"
+#include "hsfcPolicy.h"
 
 using namespace std;
 
@@ -28,16 +29,22 @@ public:
 	void Initialise();
 	void FromSchema(hsfcRuleSchema* RuleSchema, bool LowSpeed);
 	void OptimiseInputs(hsfcSchema* Schema);
-	void CreateLookupTable();
-	int Execute(hsfcState* State);
-	int HighSpeedExecute(hsfcState* State);
-	int Test(hsfcState* State);
+	void CreateLookupTable(hsfcRuleContext* Context);
+	void FindRecursiveInputs(vector<int>& StratumOutput);
+	void CreateContext(hsfcRuleContext* Context);
+	void FreeContext(hsfcRuleContext* Context);
+	int Execute(hsfcState* State, hsfcRuleContext* Context);
+	int HighSpeedExecute(hsfcState* State, hsfcRuleContext* Context);
+	int DeltaExecute(hsfcState* State, hsfcRuleContext* Context, bool LowSpeed, unsigned int* DeltaFirst, unsigned int* DeltaLast, bool FirstPass);
+	int Test(hsfcState* State, hsfcRuleContext* Context);
 	void Print(bool ResetVariables);
 
-	int Transactions;
 	double LookupSize;
 	bool LowSpeed;
 	int SelfReferenceCount;
+	int Result;
+	int NumRecursiveInputs;
+	bool RecursiveCondition;
 
 protected:
 
@@ -49,29 +56,31 @@ private:
 	void TestCalculator(hsfcCalculator& Calculator);
 	void PrintCalculator(hsfcCalculator& Calculator, bool ResetVariables);
 
-	void ClearVariables(int LowInputIndex);
-	bool InitialiseInput(hsfcState* State);
-	bool AdvanceInput(int* LowInputIndex, int InputIndex, hsfcState* State);
-	bool AdvanceInput(int* LowInputIndex, int InputIndex);
-	bool LoadInput(int InputIndex, hsfcState* State);
-	bool LoadInput(int InputIndex);
-	unsigned int PreConditionID(int Index);
-	bool CheckPreConditions(hsfcState* State);
-	unsigned int ConditionID(int Index);
-	bool CheckConditions(hsfcState* State);
-	unsigned int ResultID();
-	bool PostResult(hsfcState* State);
+	void ClearVariables(hsfcRuleContext* Context, int LowInputIndex);
+	bool InitialiseInput(hsfcRuleContext* Context, hsfcState* State);
+	unsigned int InputEnd(hsfcRuleContext* Context, int InputIndex, hsfcState* State);
+	void ResetInputRange(hsfcRuleContext* Context);
+	bool AdvanceInput(hsfcRuleContext* Context, int* LowInputIndex, int InputIndex, hsfcState* State);
+	bool AdvanceInput(hsfcRuleContext* Context, int* LowInputIndex, int InputIndex);
+	bool LoadInput(hsfcRuleContext* Context, int InputIndex, hsfcState* State);
+	bool LoadInput(hsfcRuleContext* Context, int InputIndex);
+	unsigned int PreConditionID(hsfcRuleContext* Context, int Index);
+	bool CheckPreConditions(hsfcRuleContext* Context, hsfcState* State);
+	unsigned int ConditionID(hsfcRuleContext* Context, int Index);
+	bool CheckConditions(hsfcRuleContext* Context, hsfcState* State);
+	unsigned int ResultID(hsfcRuleContext* Context);
+	bool PostResult(hsfcRuleContext* Context, hsfcState* State);
+	void CopyCalculator(hsfcCalculator& Source, hsfcCalculator& Destination);
 
 	hsfcLexicon* Lexicon;
 	hsfcStateManager* StateManager;
 	hsfcDomainManager* DomainManager;
 	hsfcRuleSchema* RuleSchema;
 
-	int* Cursor;
+	// The plan shared by every context; only Variable[].InputIndex is read
 	hsfcBufferTerm* Variable;
 	int VariableSize;
 
-	int Result;
 	hsfcCalculator ResultCalculator;
 	unsigned int ResultLookupSize;
 	unsigned int* ResultLookup;
@@ -79,6 +88,7 @@ private:
 	int NumInputs;
 	int* InputCount;
 	int* Input;
+	int* InputDelta;
 	hsfcCalculator* InputCalculator;
 	unsigned int* MaxInputLookup;
 	unsigned int* InputLookupSize;
@@ -113,9 +123,11 @@ public:
 
 	void Initialise();
 	bool Create(hsfcStratumSchema* StratumSchema, bool LowSpeedOnly);
-	void CreateLookupTables();
-	void ExecuteRules(hsfcState* State, bool LowSpeed);
-	void TestRules(hsfcState* State);
+	void CreateLookupTables(hsfcStratumContext* Context);
+	void CreateContext(hsfcStratumContext* Context);
+	void FreeContext(hsfcStratumContext* Context);
+	void ExecuteRules(hsfcState* State, hsfcStratumContext* Context, bool LowSpeed);
+	void TestRules(hsfcState* State, hsfcStratumContext* Context);
 	void Print();
 
 	vector<hsfcRule*> Rule;
@@ -134,6 +146,8 @@ private:
 	hsfcStateManager* StateManager;
 	hsfcDomainManager* DomainManager;
 
+	vector<int> Output;
+
 };
 
 //=============================================================================
@@ -148,12 +162,20 @@ public:
 	void Initialise();
 	bool Create(hsfcSchema* Schema, bool LowSpeedOnly);
 
+	hsfcContext* CreateContext();
+	void FreeContext(hsfcContext* Context);
+	void SeedRandom(hsfcContext* Context, unsigned long long Seed);
+
 	void SetInitialState(hsfcState* State);
-	void AdvanceState(hsfcState* State, int Step, bool LowSpeed);
+	void AdvanceState(hsfcState* State, int Step, bool LowSpeed, hsfcContext* Context);
+	void ExecutePlan(hsfcState* State, vector<unsigned int>& Plan, hsfcContext* Context);
 	bool IsTerminal(hsfcState* State);
-	int GoalValue(hsfcState* State, int RoleIndex);
+	int GoalValue(hsfcState* State, int RoleIndex, hsfcContext* Context);
+	void GoalValues(hsfcState* State, vector<int>& GoalValue, hsfcContext* Context);
 	void GetLegalMoves(hsfcState* State, vector< vector<hsfcLegalMove> >& LegalMove);
-	void ChooseRandomMoves(hsfcState* State);
+	void GetLegalMoves(hsfcState* State, unsigned int RoleIndex, vector<hsfcLegalMove>& LegalMove);
+	void ChooseRandomMoves(hsfcState* State, hsfcContext* Context);
+	void ChoosePolicyMoves(hsfcState* State, hsfcPolicy* Policy, hsfcContext* Context);
 	void Print();
 
 	vector<hsfcStratum*> Stratum;
@@ -161,10 +183,22 @@ public:
 	int LastStratumIndex[6];
 	double LookupSize;
 
+	// The strata each query depends on, in execution order
+	vector<unsigned int> TerminalPlan;
+	vector<unsigned int> LegalPlan;
+	vector<unsigned int> GoalPlan;
+	vector<unsigned int> NextPlan;
+
+	// Used by the engine itself and by callers that never run concurrently
+	hsfcContext* Context;
+
 protected:
 
 private:
-	void ProcessRules(hsfcState* State, int Step, bool LowSpeed, bool ProcessRigids);
+	void ProcessRules(hsfcState* State, int Step, bool LowSpeed, bool ProcessRigids, hsfcContext* Context);
+	unsigned long long NextRandom(hsfcContext* Context);
+	unsigned int RandomIndex(hsfcContext* Context, unsigned int Range);
+	double RandomUnit(hsfcContext* Context);
 	void DeleteStrata();
 	void SetStratumProperties();
 	bool CalculateRigids();
@@ -177,5 +211,6 @@ private:
 	hsfcState* State;
 	hsfcSchema* Schema;
 	vector<vector<int> > Step;
+	unsigned int NumContexts;
 
 };
@@ -600,6 +600,7 @@ void hsfcStratumSchema::Initialise(hsfcSCLStratum* SCLStratum){
 	for (unsigned int i = 0; i < SCLStratum->Output.size(); i++) this->Output.push_back(SCLStratum->Output[i]);
 
 	this->Rigidity = hsfcRigidityNone;
+	this->Type = hsfcStratumNone;
 
 	
 
@@ -56,6 +56,12 @@ void hsfcStateManager::Initialise(){
 	if (this->NextRelationIndex != NULL) delete[](this->NextRelationIndex);
 	this->NoNextRelation = 0;
 	this->StateSize = 0;
+	this->ArenaSize = 0;
+	this->ArenaCopyOffset = 0;
+	this->ArenaListOffset = 0;
+	this->NumRoles = 0;
+	this->NumLegalRoles = 0;
+	this->RoleLegalCapacity = 0;
 	this->MaxRelationSize = 0;
 	//this->FullPermanent.clear(); 
 	//this->PartPermanent.clear(); 
@@ -78,8 +84,10 @@ bool hsfcStateManager::SetSchema(hsfcSchema* Schema){
 	hsfcTuple* LegalEntry;
 	hsfcTuple* DoesEntry;
 	hsfcTuple* SeesEntry;
+	hsfcTuple GoalTerm[3];
 	int TrueIndex;
 	hsfcReference NewReference;
+	hsfcRelationSchema* RelationSchema;
 
 	this->Lexicon->IO->WriteToLog(2, true, "Translating Schema ...\n");
 
@@ -137,43 +145,13 @@ bool hsfcStateManager::SetSchema(hsfcSchema* Schema){
 		}
 	}
 
-	this->Lexicon->IO->WriteToLog(2, true, "  Sizing State\n");
-
-	// Check the maximum relation size
-	if (this->MaxRelationSize < MAX_DOMAIN_ENTRIES) {
-		this->Lexicon->IO->WriteToLog(0, false, "Warning: resetting MaxRelationSize = MAX_DOMAIN_ENTRIES hsfcStateManager::SetSchema\n");
-		//this->MaxRelationSize = MAX_DOMAIN_ENTRIES;
-	}
-
-	// Calculate the sizes of the state
-	this->StateSize = 0;
-	for (unsigned int i = 1; i < this->Schema->RelationSchema.size(); i++) {
-		if (this->Schema->RelationSchema[i]->IsInState) {
-			// Calculate the size of the state
-			if (this->DomainManager->Domain[i].IDCount > this->MaxRelationSize) {
-				this->StateSize += this->MaxRelationSize * sizeof(unsigned int);
-				this->StateSize += this->MaxRelationSize * sizeof(unsigned int);
-				this->Lexicon->IO->FormatToLog(4, true, "    Relation %d  Size = %d\n", i, 2 * this->MaxRelationSize * sizeof(unsigned int));
-			} else {
-				this->StateSize += this->DomainManager->Domain[i].IDCount * sizeof(unsigned int);
-				this->StateSize += this->DomainManager->Domain[i].IDCount * sizeof(bool);
-				this->Lexicon->IO->FormatToLog(4, true, "    Relation %d  Size = %d\n", i, this->DomainManager->Domain[i].IDCount * sizeof(unsigned int) + this->DomainManager->Domain[i].IDCount * sizeof(bool));
-			}
-		}
-		// Is the state too big
-		this->Lexicon->IO->Parameters->StateSize = this->StateSize;
-		if (this->StateSize > this->Lexicon->IO->Parameters->MaxStateSize) {
-			this->Lexicon->IO->WriteToLog(0, false, "Error: state too big in hsfcStateManager::SetSchema\n");
-			return false;
-		}
-	}
-
 	// Cross link goal, legal, does, sees to role
 	if (this->RoleRelationIndex == 0) {
 		this->Lexicon->IO->WriteToLog(0, false, "Error: no (role ...) relation found in hsfcStateManager::SetSchema\n");
 		return false;
 	} else {
 		RoleSize = this->DomainManager->Domain[this->RoleRelationIndex].Size[0];
+		this->NumRoles = RoleSize;
 	}
 
 	// Goal to role
@@ -200,6 +178,16 @@ bool hsfcStateManager::SetSchema(hsfcSchema* Schema){
 				this->GoalToRole[i] = j;
 			}
 		}
+
+		// Read the role and value of every goal relation once rather than in every playout
+		this->GoalTable.resize(this->DomainManager->Domain[this->GoalRelationIndex].IDCount);
+		for (unsigned int i = 0; i < this->GoalTable.size(); i++) {
+			this->GoalTable[i].RoleIndex = this->GoalToRole[i % Size];
+			this->GoalTable[i].Value = 0;
+			if (this->DomainManager->IDToTerms(this->GoalRelationIndex, GoalTerm, i)) {
+				this->GoalTable[i].Value = atoi(this->Lexicon->Text(GoalTerm[2].ID));
+			}
+		}
 	}
 
 	// Legal to role
@@ -212,6 +200,7 @@ bool hsfcStateManager::SetSchema(hsfcSchema* Schema){
 
 		// Create the cross link
 		Size = this->DomainManager->Domain[this->LegalRelationIndex].Size[0];
+		this->NumLegalRoles = Size;
 		this->LegalToRole = new unsigned int[Size];
 
 		// Populate the cross reference for each Legal entry
@@ -298,6 +287,59 @@ bool hsfcStateManager::SetSchema(hsfcSchema* Schema){
 		}
 	}
 
+	// Record the relation lists read and calculated by each stratum
+	this->Lexicon->IO->WriteToLog(2, true, "  Setting stratum dependencies\n");
+
+	// Reset the lists
+	this->NumStrata = this->Schema->StratumSchema.size();
+	this->StratumInput.clear();
+	this->StratumOutput.clear();
+	this->StratumRigid.clear();
+	this->StratumInput.resize(this->NumStrata);
+	this->StratumOutput.resize(this->NumStrata);
+	this->StratumRigid.resize(this->NumStrata, false);
+	this->Calculated.assign(this->Schema->RelationSchema.size(), false);
+	this->Transferred.assign(this->Schema->RelationSchema.size(), false);
+	this->PartPermanentCount.assign(this->Schema->RelationSchema.size(), 0);
+
+	// Translate the stratum inputs and outputs into relation lists
+	for (unsigned int i = 0; i < this->NumStrata; i++) {
+		this->StratumRigid[i] = (this->Schema->StratumSchema[i]->Rigidity == hsfcRigidityFull);
+		for (unsigned int j = 0; j < this->Schema->StratumSchema[i]->Input.size(); j++) {
+			// Ignore (distinct ...) and relations that are not stored in the state
+			RelationSchema = this->Schema->FindRelationSchema(this->Schema->StratumSchema[i]->Input[j]);
+			if ((RelationSchema == NULL) || (!RelationSchema->IsInState)) continue;
+			this->StratumInput[i].push_back(RelationSchema->Index);
+		}
+		for (unsigned int j = 0; j < this->Schema->StratumSchema[i]->Output.size(); j++) {
+			RelationSchema = this->Schema->FindRelationSchema(this->Schema->StratumSchema[i]->Output[j]);
+			if ((RelationSchema == NULL) || (!RelationSchema->IsInState)) continue;
+			this->StratumOutput[i].push_back(RelationSchema->Index);
+			if (!this->StratumRigid[i]) this->Calculated[RelationSchema->Index] = true;
+		}
+	}
+
+	// Fluents with a (next ...) are transferred rather than cleared
+	for (unsigned int i = 0; i < this->Next.size(); i++) {
+		this->Transferred[this->Next[i].DestinationIndex] = true;
+	}
+
+	// Count the permanent relations in each list
+	for (unsigned int i = 0; i < this->PartPermanent.size(); i++) {
+		this->PartPermanentCount[this->PartPermanent[i].Index]++;
+	}
+
+	this->Lexicon->IO->WriteToLog(2, true, "  Sizing State\n");
+
+	// Check the maximum relation size
+	if (this->MaxRelationSize < MAX_DOMAIN_ENTRIES) {
+		this->Lexicon->IO->WriteToLog(0, false, "Warning: resetting MaxRelationSize = MAX_DOMAIN_ENTRIES hsfcStateManager::SetSchema\n");
+		//this->MaxRelationSize = MAX_DOMAIN_ENTRIES;
+	}
+
+	// Lay out the arena shared by all states
+	if (!this->LayoutArena()) return false;
+
 	this->Lexicon->IO->FormatToLog(3, true, "  State Size = %u\n", this->StateSize);
 	this->Lexicon->IO->WriteToLog(2, true, "succeeded\n");
 
@@ -328,6 +370,16 @@ hsfcState* hsfcStateManager::CreateState(void){
 	State->RelationID = NULL;
 	State->RelationExists = NULL;
 	State->RelationIDSorted = NULL;
+	State->RelationChanged = NULL;
+	State->StratumValid = NULL;
+	State->NumDirtyRelations = 0;
+	State->DirtyRelation = NULL;
+	State->RelationDirty = NULL;
+	State->NextSwapped = NULL;
+	State->NumRoleLegals = NULL;
+	State->RoleLegalID = NULL;
+	State->Arena = NULL;
+	State->ArenaBlock = NULL;
 
 	return State;
 
@@ -339,40 +391,24 @@ hsfcState* hsfcStateManager::CreateState(void){
 void hsfcStateManager::FreeState(hsfcState* State){
 
 	// Is there actually a state to free
-	if (State->RelationID == NULL) return;
+	if (State->ArenaBlock == NULL) return;
 	
-	// Free the memory for the state
-	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		if ((State->RelationID[i] != NULL) && (State->RelationID[i] != NULL)) {
-			delete[](State->RelationID[i]);
-		}
-		if ((State->RelationExists != NULL) && (State->RelationExists[i] != NULL)) {
-			delete[](State->RelationExists[i]);
-		}
-		if ((State->RelationIDSorted != NULL) && (State->RelationIDSorted[i] != NULL)) {
-			delete[](State->RelationIDSorted[i]);
-		}
-	}
-	if (State->MaxNumRelations != NULL) {
-		delete[](State->MaxNumRelations);
-		State->MaxNumRelations = NULL;
-	}
-	if (State->NumRelations != NULL) {
-		delete[](State->NumRelations);
-		State->NumRelations = NULL;
-	}
-	if (State->RelationID != NULL) {
-		delete[](State->RelationID);
-		State->RelationID = NULL;
-	}
-	if (State->RelationExists != NULL) {
-		delete[](State->RelationExists);
-		State->RelationExists = NULL;
-	}
-	if (State->RelationIDSorted != NULL) {
-		delete[](State->RelationIDSorted);
-		State->RelationID = NULL;
-	}
+	// Free the memory for the state; all of the arrays are in the arena
+	delete[](State->ArenaBlock);
+	State->ArenaBlock = NULL;
+	State->Arena = NULL;
+	State->MaxNumRelations = NULL;
+	State->NumRelations = NULL;
+	State->RelationID = NULL;
+	State->RelationExists = NULL;
+	State->RelationIDSorted = NULL;
+	State->RelationChanged = NULL;
+	State->StratumValid = NULL;
+	State->DirtyRelation = NULL;
+	State->RelationDirty = NULL;
+	State->NextSwapped = NULL;
+	State->NumRoleLegals = NULL;
+	State->RoleLegalID = NULL;
 
 }
 
@@ -384,43 +420,44 @@ void hsfcStateManager::InitialiseState(hsfcState* State){
 	// Free the memory for the state
 	this->FreeState(State);
 
-	// Initialise the State from the Schema
-	this->NumRelationLists = this->Schema->RelationSchema.size();
-
-	// Create the arrays for each relation list
-	State->NumRelations = new unsigned int[this->NumRelationLists];
-	State->MaxNumRelations = new unsigned int[this->NumRelationLists];
-	State->RelationID = new unsigned int*[this->NumRelationLists];
-	State->RelationExists = new bool*[this->NumRelationLists];
-	State->RelationIDSorted = new unsigned int*[this->NumRelationLists];
-
-	// Create the arrays for each relation
+	// Create the arena aligned to the cache line
+	State->ArenaBlock = new char[this->ArenaSize + ARENA_ALIGNMENT];
+	State->Arena = State->ArenaBlock + (ARENA_ALIGNMENT - ((size_t)State->ArenaBlock % ARENA_ALIGNMENT)) % ARENA_ALIGNMENT;
+
+	// Clear everything except the relation lists; no stratum has been calculated yet
+	memset(State->Arena, 0, this->ArenaListOffset);
+
+	// Point the arrays into the arena
+	State->RelationID = (unsigned int**)(State->Arena + this->RelationIDTableOffset);
+	State->RelationExists = (hsfcExistsWord**)(State->Arena + this->RelationExistsTableOffset);
+	State->RelationIDSorted = (unsigned int**)(State->Arena + this->RelationIDSortedTableOffset);
+	State->MaxNumRelations = (unsigned int*)(State->Arena + this->MaxNumRelationsOffset);
+	State->NumRelations = (unsigned int*)(State->Arena + this->NumRelationsOffset);
+	State->RelationChanged = (bool*)(State->Arena + this->RelationChangedOffset);
+	State->StratumValid = (bool*)(State->Arena + this->StratumValidOffset);
+	State->DirtyRelation = (unsigned int*)(State->Arena + this->DirtyRelationOffset);
+	State->RelationDirty = (bool*)(State->Arena + this->RelationDirtyOffset);
+	State->NextSwapped = (bool*)(State->Arena + this->NextSwappedOffset);
+	State->NumRoleLegals = (unsigned int*)(State->Arena + this->NumRoleLegalsOffset);
+	State->RoleLegalID = (unsigned int**)(State->Arena + this->RoleLegalTableOffset);
+	State->NumDirtyRelations = 0;
+
+	// Point each relation into the arena
 	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		State->NumRelations[i] = 0;
-		State->MaxNumRelations[i] = 0;
-		State->RelationID[i] = NULL;
-		State->RelationIDSorted[i] = NULL;
-		State->RelationExists[i] = NULL;
-		if (this->Schema->RelationSchema[i]->IsInState) {
-			if (this->DomainManager->Domain[i].IDCount < this->MaxRelationSize) {
-				State->MaxNumRelations[i] = this->DomainManager->Domain[i].IDCount;
-				State->RelationID[i] = new unsigned int[State->MaxNumRelations[i]];
-				this->StateSize += State->MaxNumRelations[i] * sizeof(int);
-				State->RelationExists[i] = new bool[State->MaxNumRelations[i]];
-				this->StateSize += State->MaxNumRelations[i] * sizeof(bool);
-				// Clear the exists array
-				for (unsigned int j = 0; j < State->MaxNumRelations[i]; j++) {
-					State->RelationExists[i][j] = false;
-				}
-			} else {
-				State->MaxNumRelations[i] = this->MaxRelationSize;
-				State->RelationID[i] = new unsigned int[this->MaxRelationSize];
-				this->StateSize += this->MaxRelationSize * sizeof(int);
-				State->RelationIDSorted[i] = new unsigned int[this->MaxRelationSize];
-				this->StateSize += this->MaxRelationSize * sizeof(int);
-			}
+		State->MaxNumRelations[i] = this->RelationCapacity[i];
+		if (this->RelationIDOffset[i] != UNDEFINED) {
+			State->RelationID[i] = (unsigned int*)(State->Arena + this->RelationIDOffset[i]);
+		}
+		if (this->RelationExistsOffset[i] != UNDEFINED) {
+			State->RelationExists[i] = (hsfcExistsWord*)(State->Arena + this->RelationExistsOffset[i]);
+		}
+		if (this->RelationIDSortedOffset[i] != UNDEFINED) {
+			State->RelationIDSorted[i] = (unsigned int*)(State->Arena + this->RelationIDSortedOffset[i]);
 		}
 	}
+	for (unsigned int i = 0; i < this->NumRoles; i++) {
+		State->RoleLegalID[i] = (unsigned int*)(State->Arena + this->RoleLegalOffset) + i * this->RoleLegalCapacity;
+	}
 
 	// Add the permanent relations from the reference table
 	for (unsigned int i = 0; i < this->FullPermanent.size(); i++) {
@@ -438,28 +475,36 @@ void hsfcStateManager::InitialiseState(hsfcState* State){
 //-----------------------------------------------------------------------------
 void hsfcStateManager::FromState(hsfcState* State, hsfcState* Source){
 
-	// Initialise the state
-	this->ResetState(State);
+	unsigned int Index;
 
-	// Copy the relations
-	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		if (this->Schema->RelationSchema[i]->Rigidity != hsfcRigidityFull) {
-			for (unsigned int j = 0; j < Source->NumRelations[i]; j++) {
-				if (State->RelationID[i] != NULL) {
-					State->RelationID[i][j] = Source->RelationID[i][j];
-				}
-				if (State->RelationExists[i] != NULL) {
-					State->RelationExists[i][Source->RelationID[i][j]] = true;
-				}
-				if (State->RelationIDSorted[i] != NULL) {
-					State->RelationIDSorted[i][j] = Source->RelationIDSorted[i][j];
-				}
+	// Both states share the same layout; except for next and true lists that have swapped buffers
+	for (unsigned int i = 0; i < this->Next.size(); i++) {
+		if (State->NextSwapped[i] != Source->NextSwapped[i]) {
+			this->SwapBuffers(State, this->Next[i].SourceIndex, this->Next[i].DestinationIndex);
+		}
+	}
+
+	// Copy the counts, flags and exists arrays as a single block
+	memcpy(State->Arena + this->ArenaCopyOffset, Source->Arena + this->ArenaCopyOffset, this->ArenaListOffset - this->ArenaCopyOffset);
+
+	// Copy the dirty relations; only as far as each list is filled
+	for (unsigned int i = 0; i < Source->NumDirtyRelations; i++) {
+		Index = Source->DirtyRelation[i];
+		if (State->RelationID[Index] != NULL) {
+			memcpy(State->RelationID[Index], Source->RelationID[Index], Source->NumRelations[Index] * sizeof(unsigned int));
+		}
+		if (State->RelationIDSorted[Index] != NULL) {
+			memcpy(State->RelationIDSorted[Index], Source->RelationIDSorted[Index], Source->NumRelations[Index] * sizeof(unsigned int));
+		}
+		if (Index == this->LegalRelationIndex) {
+			for (unsigned int j = 0; j < this->NumRoles; j++) {
+				memcpy(State->RoleLegalID[j], Source->RoleLegalID[j], Source->NumRoleLegals[j] * sizeof(unsigned int));
 			}
-			State->NumRelations[i] = Source->NumRelations[i];
 		}
 	}
 
 	// Copy the details
+	State->NumDirtyRelations = Source->NumDirtyRelations;
 	State->CurrentStep = Source->CurrentStep;
 	State->Round = Source->Round;
 
@@ -470,17 +515,24 @@ void hsfcStateManager::FromState(hsfcState* State, hsfcState* Source){
 //-----------------------------------------------------------------------------
 void hsfcStateManager::ResetState(hsfcState* State) {
 
-	// Go through all of the relations and clear all the lists; except the permanent facts
-	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		if (this->Schema->RelationSchema[i]->Rigidity != hsfcRigidityFull) {
-			if (State->RelationExists[i] != NULL) {
-				for (unsigned int j = 0; j < State->NumRelations[i]; j++) {
-					State->RelationExists[i][State->RelationID[i][j]] = false;
-				}
-			}
-			State->NumRelations[i] = 0;
+	unsigned int Index;
+
+	// Clear all the lists that have been added to; the permanent facts are never dirty
+	for (unsigned int i = 0; i < State->NumDirtyRelations; i++) {
+		Index = State->DirtyRelation[i];
+		if (State->RelationExists[Index] != NULL) {
+			this->ClearExists(State, Index);
+		}
+		State->NumRelations[Index] = 0;
+		State->RelationDirty[Index] = false;
+		if (Index == this->LegalRelationIndex) {
+			memset(State->NumRoleLegals, 0, this->NumRoles * sizeof(unsigned int));
 		}
 	}
+	State->NumDirtyRelations = 0;
+
+	// Every stratum must be recalculated
+	memset(State->StratumValid, 0, this->NumStrata * sizeof(bool));
 
 }
 
@@ -515,24 +567,18 @@ void hsfcStateManager::NextState(hsfcState* State) {
 
 	int SourceIndex;
 	int DestinationIndex;
+	unsigned int Index;
+	unsigned int Count;
 	hsfcTuple NewTuple;
+	bool Recalculate;
 
 	// (next (cell ... ...)) ==> (cell ... ...)
 	// (next_cell ... ...) ==> (cell ... ...)
 	// Domains for (next_cell ) and (cell ) are identical
-	// So the lists can just be copied
+	// So the lists can just exchange buffers
 
-	// Clear all of the lists except for the rigid and the next relations
-	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		if ((this->Schema->RelationSchema[i]->Rigidity != hsfcRigidityFull) && (this->Schema->RelationSchema[i]->Fact != hsfcFactNext)) {
-			if (State->RelationExists[i] != NULL) {
-				for (unsigned int j = 0; j < State->NumRelations[i]; j++) {
-					State->RelationExists[i][State->RelationID[i][j]] = false;
-				}
-			}
-			State->NumRelations[i] = 0;
-		}
-	}
+	// Keep track of which lists change
+	memset(State->RelationChanged, 0, this->NumRelationLists * sizeof(bool));
 
 	// Transfer the lists from next to predicate
 	for (unsigned int i = 0; i < this->Next.size(); i++) {
@@ -540,32 +586,102 @@ void hsfcStateManager::NextState(hsfcState* State) {
 		SourceIndex = this->Next[i].SourceIndex;
 		DestinationIndex = this->Next[i].DestinationIndex;
 
-		// Transfer of relations
-		// There is an opportunity for a bulk transfer flag
-		for (unsigned int j = 0; j < State->NumRelations[SourceIndex]; j++) {
-			NewTuple.Index = DestinationIndex;
-			NewTuple.ID = State->RelationID[SourceIndex][j];
-			this->AddRelation(State, NewTuple);
+		// Fluents that persist are left alone
+		if (this->SameRelations(State, SourceIndex, DestinationIndex)) continue;
+
+		State->RelationChanged[DestinationIndex] = true;
+
+		// Transfer of relations by copying
+		if (!this->NextSwappable[i]) {
+			this->ClearRelation(State, DestinationIndex);
+			for (unsigned int j = 0; j < State->NumRelations[SourceIndex]; j++) {
+				NewTuple.Index = DestinationIndex;
+				NewTuple.ID = State->RelationID[SourceIndex][j];
+				this->AddRelation(State, NewTuple);
+			}
+			continue;
 		}
 
+		// Transfer of relations by exchanging buffers
+		this->SwapBuffers(State, SourceIndex, DestinationIndex);
+		State->NextSwapped[i] = !State->NextSwapped[i];
+		Count = State->NumRelations[SourceIndex];
+		State->NumRelations[SourceIndex] = State->NumRelations[DestinationIndex];
+		State->NumRelations[DestinationIndex] = Count;
+		if ((State->NumRelations[SourceIndex] > 0) && !State->RelationDirty[SourceIndex]) this->MarkDirty(State, SourceIndex);
+		if ((State->NumRelations[DestinationIndex] > 0) && !State->RelationDirty[DestinationIndex]) this->MarkDirty(State, DestinationIndex);
+
+		// Put back any permanent relations eg. (true (control ...))
+		if (this->PartPermanentCount[DestinationIndex] > 0) {
+			for (unsigned int j = 0; j < this->PartPermanent.size(); j++) {
+				if (this->PartPermanent[j].Index == DestinationIndex) this->AddRelation(State, this->PartPermanent[j]);
+			}
+		}
+
+		// The next list now holds the old fluents; its stratum must recalculate it
+		State->RelationChanged[SourceIndex] = true;
+
 	}
 
-	// Clear all of the next> lists
-	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
-		if (this->Schema->RelationSchema[i]->Fact == hsfcFactNext) {
-			if (State->RelationExists[i] != NULL) {
-				for (unsigned int j = 0; j < State->NumRelations[i]; j++) {
-					State->RelationExists[i][State->RelationID[i][j]] = false;
+	// Clear the lists that are not calculated by a stratum eg. (does ...)
+	// Only dirty lists can hold more than their permanent relations
+	for (unsigned int i = 0; i < State->NumDirtyRelations; i++) {
+		Index = State->DirtyRelation[i];
+		if (this->Calculated[Index] || this->Transferred[Index]) continue;
+		if (State->NumRelations[Index] > this->PartPermanentCount[Index]) {
+			this->ClearRelation(State, Index);
+			State->RelationChanged[Index] = true;
+		}
+	}
+
+	// Strata whose inputs are unchanged keep their outputs; the rest must be recalculated
+	// Strata are in dependency order so the changes flow downstream
+	for (unsigned int i = 0; i < this->NumStrata; i++) {
+
+		if (this->StratumRigid[i]) continue;
+
+		// Have any of the inputs changed; or an output been swapped out
+		if (State->StratumValid[i]) {
+			Recalculate = false;
+			for (unsigned int j = 0; j < this->StratumInput[i].size(); j++) {
+				if (State->RelationChanged[this->StratumInput[i][j]]) {
+					Recalculate = true;
+					break;
 				}
 			}
-			State->NumRelations[i] = 0;
+			for (unsigned int j = 0; j < this->StratumOutput[i].size(); j++) {
+				if (State->RelationChanged[this->StratumOutput[i][j]]) {
+					Recalculate = true;
+					break;
+				}
+			}
+			if (!Recalculate) continue;
+			State->StratumValid[i] = false;
+		}
+
+		// Clear the outputs; anything downstream must also be recalculated
+		for (unsigned int j = 0; j < this->StratumOutput[i].size(); j++) {
+			Index = this->StratumOutput[i][j];
+			if (State->NumRelations[Index] > this->PartPermanentCount[Index]) {
+				this->ClearRelation(State, Index);
+			}
+			State->RelationChanged[Index] = true;
 		}
+
 	}
 
-	// Add in any permanent relations that are in nonpermanent lists eg. (legal role noop)
-	for (unsigned int i = 0; i < this->PartPermanent.size(); i++) {
-		this->AddRelation(State, this->PartPermanent[i]);
+	// Empty lists are no longer dirty
+	Count = 0;
+	for (unsigned int i = 0; i < State->NumDirtyRelations; i++) {
+		Index = State->DirtyRelation[i];
+		if (State->NumRelations[Index] == 0) {
+			State->RelationDirty[Index] = false;
+		} else {
+			State->DirtyRelation[Count] = Index;
+			Count++;
+		}
 	}
+	State->NumDirtyRelations = Count;
 
 	// Advance the Cycle counter
 	State->Round = State->Round + 1;
@@ -665,6 +781,9 @@ bool hsfcStateManager::AddRelation(hsfcState* State, hsfcTuple& Tuple){
 			return false;
 		}
 
+		// Keep track of the lists that have been added to
+		if (!State->RelationDirty[Tuple.Index]) this->MarkDirty(State, Tuple.Index);
+
 		// Shuffle everything down
 		for (int i = State->NumRelations[Tuple.Index]; i > Target; i--) {
 			State->RelationIDSorted[Tuple.Index][i] = State->RelationIDSorted[Tuple.Index][i - 1];
@@ -675,20 +794,23 @@ bool hsfcStateManager::AddRelation(hsfcState* State, hsfcTuple& Tuple){
 
 		// Increment the number of relations in the list
 		State->NumRelations[Tuple.Index]++;
+		if (Tuple.Index == this->LegalRelationIndex) this->AddRoleLegal(State, Tuple.ID);
 
 		return true;
 
 	} else {
 
 		// Uses Exists
-		if (State->RelationExists[Tuple.Index][Tuple.ID]) {
+		if (EXISTS_TEST(State->RelationExists[Tuple.Index], Tuple.ID)) {
 			return false;
 		} else {
 			// Add it to the list
+			if (!State->RelationDirty[Tuple.Index]) this->MarkDirty(State, Tuple.Index);
 			State->RelationID[Tuple.Index][State->NumRelations[Tuple.Index]] = Tuple.ID;
-			State->RelationExists[Tuple.Index][Tuple.ID] = true;
+			EXISTS_SET(State->RelationExists[Tuple.Index], Tuple.ID);
 			// Increment the number of relations in the list
 			State->NumRelations[Tuple.Index]++;
+			if (Tuple.Index == this->LegalRelationIndex) this->AddRoleLegal(State, Tuple.ID);
 			return true;
 		}
 
@@ -747,10 +869,289 @@ bool hsfcStateManager::RelationExists(hsfcState* State, hsfcTuple& Tuple){
 	} else {
 
 		// Uses Exists
-		return State->RelationExists[Tuple.Index][Tuple.ID];
+		return (EXISTS_TEST(State->RelationExists[Tuple.Index], Tuple.ID) != 0);
+
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// LegalExists
+//-----------------------------------------------------------------------------
+bool hsfcStateManager::LegalExists(hsfcState* State, unsigned int RoleIndex, unsigned int RelationID){
 
+	hsfcTuple Tuple;
+
+	// The ID must be in the domain and be a move for the role
+	if (this->LegalToRole == NULL) return false;
+	if (RelationID >= this->DomainManager->Domain[this->LegalRelationIndex].IDCount) return false;
+	if (this->LegalToRole[RelationID % this->NumLegalRoles] != RoleIndex) return false;
+
+	// Look it up in the legal relation
+	Tuple.Index = this->LegalRelationIndex;
+	Tuple.ID = RelationID;
+	return this->RelationExists(State, Tuple);
+
+}
+
+//-----------------------------------------------------------------------------
+// ClearRelation
+//-----------------------------------------------------------------------------
+void hsfcStateManager::ClearRelation(hsfcState* State, unsigned int Index){
+
+	// Clear the list
+	if (State->RelationExists[Index] != NULL) {
+		this->ClearExists(State, Index);
+	}
+	State->NumRelations[Index] = 0;
+	if (Index == this->LegalRelationIndex) {
+		memset(State->NumRoleLegals, 0, this->NumRoles * sizeof(unsigned int));
+	}
+
+	// Add in any permanent relations that are in nonpermanent lists eg. (legal role noop)
+	if (this->PartPermanentCount[Index] > 0) {
+		for (unsigned int i = 0; i < this->PartPermanent.size(); i++) {
+			if (this->PartPermanent[i].Index == Index) this->AddRelation(State, this->PartPermanent[i]);
+		}
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// SameRelations
+//-----------------------------------------------------------------------------
+bool hsfcStateManager::SameRelations(hsfcState* State, unsigned int Index1, unsigned int Index2){
+
+	// The lists must be the same size and type
+	if (State->NumRelations[Index1] != State->NumRelations[Index2]) return false;
+	if ((State->RelationIDSorted[Index1] == NULL) != (State->RelationIDSorted[Index2] == NULL)) return false;
+
+	// Does the list have Exists or Sorted
+	if (State->RelationIDSorted[Index1] != NULL) {
+		for (unsigned int j = 0; j < State->NumRelations[Index1]; j++) {
+			if (State->RelationIDSorted[Index1][j] != State->RelationIDSorted[Index2][j]) return false;
+		}
+	} else {
+		for (unsigned int j = 0; j < State->NumRelations[Index1]; j++) {
+			if (!EXISTS_TEST(State->RelationExists[Index2], State->RelationID[Index1][j])) return false;
+		}
+	}
+
+	return true;
+
+}
+
+//-----------------------------------------------------------------------------
+// ClearExists
+//-----------------------------------------------------------------------------
+void hsfcStateManager::ClearExists(hsfcState* State, unsigned int Index){
+
+	unsigned int NumWords;
+
+	// Sparse lists clear bit by bit; dense lists clear the whole words
+	NumWords = EXISTS_WORDS(State->MaxNumRelations[Index]);
+	if (State->NumRelations[Index] < NumWords) {
+		for (unsigned int j = 0; j < State->NumRelations[Index]; j++) {
+			EXISTS_CLEAR(State->RelationExists[Index], State->RelationID[Index][j]);
+		}
+	} else {
+		memset(State->RelationExists[Index], 0, NumWords * sizeof(hsfcExistsWord));
+	}
+
+}
+
+//-----------------------------------------------------------------------------
+// MarkDirty
+//-----------------------------------------------------------------------------
+void hsfcStateManager::MarkDirty(hsfcState* State, unsigned int Index){
+
+	// Full rigids are never cleared so they are never dirty
+	if (this->FullRigid[Index]) return;
+
+	State->RelationDirty[Index] = true;
+	State->DirtyRelation[State->NumDirtyRelations] = Index;
+	State->NumDirtyRelations++;
+
+}
+
+//-----------------------------------------------------------------------------
+// AddRoleLegal
+//-----------------------------------------------------------------------------
+void hsfcStateManager::AddRoleLegal(hsfcState* State, unsigned int RelationID){
+
+	unsigned int RoleIndex;
+
+	// The role is the first argument of the legal relation
+	RoleIndex = this->LegalToRole[RelationID % this->NumLegalRoles];
+	if (RoleIndex == UNDEFINED) return;
+	if (State->NumRoleLegals[RoleIndex] >= this->RoleLegalCapacity) {
+		this->Lexicon->IO->FormatToLog(0, false, "Warning: role %u has too many legal moves in hsfcStateManager::AddRoleLegal\n", RoleIndex);
+		return;
+	}
+
+	State->RoleLegalID[RoleIndex][State->NumRoleLegals[RoleIndex]] = RelationID;
+	State->NumRoleLegals[RoleIndex]++;
+
+}
+
+//-----------------------------------------------------------------------------
+// SwapBuffers
+//-----------------------------------------------------------------------------
+void hsfcStateManager::SwapBuffers(hsfcState* State, unsigned int Index1, unsigned int Index2){
+
+	unsigned int* RelationID;
+	hsfcExistsWord* RelationExists;
+
+	// Only the pointers are exchanged; the counts are left to the caller
+	RelationID = State->RelationID[Index1];
+	State->RelationID[Index1] = State->RelationID[Index2];
+	State->RelationID[Index2] = RelationID;
+	RelationExists = State->RelationExists[Index1];
+	State->RelationExists[Index1] = State->RelationExists[Index2];
+	State->RelationExists[Index2] = RelationExists;
+	RelationID = State->RelationIDSorted[Index1];
+	State->RelationIDSorted[Index1] = State->RelationIDSorted[Index2];
+	State->RelationIDSorted[Index2] = RelationID;
+
+}
+
+//-----------------------------------------------------------------------------
+// ArenaAlign
+//-----------------------------------------------------------------------------
+unsigned int hsfcStateManager::ArenaAlign(unsigned int Offset){
+
+	return (Offset + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+}
+
+//-----------------------------------------------------------------------------
+// LayoutArena
+//-----------------------------------------------------------------------------
+bool hsfcStateManager::LayoutArena(){
+
+	unsigned int Offset;
+	unsigned int Size;
+	unsigned int SourceIndex;
+	unsigned int DestinationIndex;
+
+	// Size each relation list
+	this->NumRelationLists = this->Schema->RelationSchema.size();
+	this->RelationCapacity.assign(this->NumRelationLists, 0);
+	this->RelationIDOffset.assign(this->NumRelationLists, UNDEFINED);
+	this->RelationExistsOffset.assign(this->NumRelationLists, UNDEFINED);
+	this->RelationIDSortedOffset.assign(this->NumRelationLists, UNDEFINED);
+	this->FullRigid.assign(this->NumRelationLists, false);
+	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
+		if (this->Schema->RelationSchema[i]->IsInState) {
+			if (this->DomainManager->Domain[i].IDCount < this->MaxRelationSize) {
+				this->RelationCapacity[i] = this->DomainManager->Domain[i].IDCount;
+			} else {
+				this->RelationCapacity[i] = this->MaxRelationSize;
+			}
+		}
+		this->FullRigid[i] = (this->Schema->RelationSchema[i]->Rigidity == hsfcRigidityFull);
 	}
 
+	// Next and true lists can exchange buffers if they are stored alike
+	// Rigid lists and lists with permanent relations are transferred by copying
+	this->NextSwappable.assign(this->Next.size(), false);
+	for (unsigned int i = 0; i < this->Next.size(); i++) {
+		SourceIndex = this->Next[i].SourceIndex;
+		DestinationIndex = this->Next[i].DestinationIndex;
+		if (this->RelationCapacity[SourceIndex] != this->RelationCapacity[DestinationIndex]) continue;
+		if (!this->Schema->RelationSchema[SourceIndex]->IsInState) continue;
+		if (!this->Schema->RelationSchema[DestinationIndex]->IsInState) continue;
+		if (this->FullRigid[SourceIndex] || this->FullRigid[DestinationIndex]) continue;
+		if (this->PartPermanentCount[SourceIndex] > 0) continue;
+		this->NextSwappable[i] = true;
+	}
+
+	// The pointer tables and capacities are fixed for the life of the state
+	Offset = 0;
+	this->RelationIDTableOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRelationLists * sizeof(unsigned int*));
+	this->RelationExistsTableOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRelationLists * sizeof(hsfcExistsWord*));
+	this->RelationIDSortedTableOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRelationLists * sizeof(unsigned int*));
+	this->MaxNumRelationsOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRelationLists * sizeof(unsigned int));
+	this->RoleLegalTableOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRoles * sizeof(unsigned int*));
+
+	// Fully rigid relations never change so their exists flags are never copied
+	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
+		if ((!this->Schema->RelationSchema[i]->IsInState) || (this->RelationCapacity[i] == this->MaxRelationSize)) continue;
+		if (this->Schema->RelationSchema[i]->Rigidity != hsfcRigidityFull) continue;
+		this->RelationExistsOffset[i] = Offset;
+		Offset = this->ArenaAlign(Offset + EXISTS_WORDS(this->RelationCapacity[i]) * sizeof(hsfcExistsWord));
+	}
+
+	// The counts, flags and exists arrays are copied as a single block
+	this->ArenaCopyOffset = Offset;
+	this->NumRelationsOffset = Offset;
+	Offset = Offset + this->NumRelationLists * sizeof(unsigned int);
+	this->DirtyRelationOffset = Offset;
+	Offset = Offset + this->NumRelationLists * sizeof(unsigned int);
+	this->NumRoleLegalsOffset = Offset;
+	Offset = Offset + this->NumRoles * sizeof(unsigned int);
+	this->RelationChangedOffset = Offset;
+	Offset = Offset + this->NumRelationLists * sizeof(bool);
+	this->RelationDirtyOffset = Offset;
+	Offset = Offset + this->NumRelationLists * sizeof(bool);
+	this->NextSwappedOffset = Offset;
+	Offset = Offset + this->Next.size() * sizeof(bool);
+	this->StratumValidOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumStrata * sizeof(bool));
+	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
+		if ((!this->Schema->RelationSchema[i]->IsInState) || (this->RelationCapacity[i] == this->MaxRelationSize)) continue;
+		if (this->Schema->RelationSchema[i]->Rigidity == hsfcRigidityFull) continue;
+		this->RelationExistsOffset[i] = Offset;
+		Offset = this->ArenaAlign(Offset + EXISTS_WORDS(this->RelationCapacity[i]) * sizeof(hsfcExistsWord));
+	}
+
+	// The relation lists are only copied as far as they are filled
+	this->ArenaListOffset = Offset;
+	for (unsigned int i = 1; i < this->NumRelationLists; i++) {
+		if (!this->Schema->RelationSchema[i]->IsInState) continue;
+		Size = this->RelationCapacity[i] * sizeof(unsigned int);
+		this->RelationIDOffset[i] = Offset;
+		Offset = this->ArenaAlign(Offset + Size);
+		if (this->RelationExistsOffset[i] == UNDEFINED) {
+			this->RelationIDSortedOffset[i] = Offset;
+			Offset = this->ArenaAlign(Offset + Size);
+			Size += Size;
+		} else {
+			Size += EXISTS_WORDS(this->RelationCapacity[i]) * sizeof(hsfcExistsWord);
+		}
+		this->Lexicon->IO->FormatToLog(4, true, "    Relation %d  Size = %u\n", i, Size);
+		// Is the state too big
+		if (Offset > this->Lexicon->IO->Parameters->MaxStateSize) {
+			this->Lexicon->IO->WriteToLog(0, false, "Error: state too big in hsfcStateManager::LayoutArena\n");
+			return false;
+		}
+	}
+
+	// Each role's legal moves; a role has at most one in every NumLegalRoles legal IDs
+	// unless the list is capped, when any one role could fill it
+	this->RoleLegalCapacity = this->RelationCapacity[this->LegalRelationIndex];
+	if (this->RoleLegalCapacity < this->MaxRelationSize) {
+		this->RoleLegalCapacity = (this->RoleLegalCapacity + this->NumLegalRoles - 1) / this->NumLegalRoles;
+	}
+	this->RoleLegalOffset = Offset;
+	Offset = this->ArenaAlign(Offset + this->NumRoles * this->RoleLegalCapacity * sizeof(unsigned int));
+	if (Offset > this->Lexicon->IO->Parameters->MaxStateSize) {
+		this->Lexicon->IO->WriteToLog(0, false, "Error: state too big in hsfcStateManager::LayoutArena\n");
+		return false;
+	}
+	this->ArenaSize = Offset;
+
+	// Record the size of the state
+	this->StateSize = this->ArenaSize;
+	this->Lexicon->IO->Parameters->StateSize = this->StateSize;
+
+	return true;
+
 }
 
 //-----------------------------------------------------------------------------
@@ -973,3 +1374,59 @@ void hsfcStateManager::CreatePermanents(hsfcState* State) {
 }
 
 
+
+//-----------------------------------------------------------------------------
+// CreatePlan
+//-----------------------------------------------------------------------------
+void hsfcStateManager::CreatePlan(unsigned int RelationIndex, vector<unsigned int>& Plan) {
+
+	vector<unsigned int> Target;
+
+	// A plan for a single relation
+	Target.push_back(RelationIndex);
+	this->CreatePlan(Target, Plan);
+
+}
+
+//--- Overload ----------------------------------------------------------------
+void hsfcStateManager::CreatePlan(vector<unsigned int>& RelationIndex, vector<unsigned int>& Plan) {
+
+	vector<bool> Required;
+	vector<bool> Include;
+
+	// The plan is every stratum the relations depend on, in execution order
+	Plan.clear();
+	Required.assign(this->NumRelationLists, false);
+	Include.assign(this->NumStrata, false);
+	for (unsigned int i = 0; i < RelationIndex.size(); i++) {
+		Required[RelationIndex[i]] = true;
+	}
+
+	// Strata are in dependency order so one backwards pass finds them all
+	for (int i = this->NumStrata - 1; i >= 0; i--) {
+
+		// Rigid strata are never recalculated
+		if (this->StratumRigid[i]) continue;
+
+		// Does the stratum calculate anything that is required
+		for (unsigned int j = 0; j < this->StratumOutput[i].size(); j++) {
+			if (Required[this->StratumOutput[i][j]]) {
+				Include[i] = true;
+				break;
+			}
+		}
+		if (!Include[i]) continue;
+
+		// Its inputs are now required
+		for (unsigned int j = 0; j < this->StratumInput[i].size(); j++) {
+			Required[this->StratumInput[i][j]] = true;
+		}
+
+	}
+
+	// List the strata in execution order
+	for (unsigned int i = 0; i < this->NumStrata; i++) {
+		if (Include[i]) Plan.push_back(i);
+	}
+
+}
@@ -44,10 +44,15 @@ public:
 
 	bool AddRelation(hsfcState* State, hsfcTuple& Tuple);
 	bool RelationExists(hsfcState* State, hsfcTuple& Tuple);
+	bool LegalExists(hsfcState* State, unsigned int RoleIndex, unsigned int RelationID);
+	void ClearRelation(hsfcState* State, unsigned int Index);
+	bool SameRelations(hsfcState* State, unsigned int Index1, unsigned int Index2);
 	void PrintRelations(hsfcState* State, bool ShowRigids);
 
 	void CreateRigids(hsfcState* State);
 	void CreatePermanents(hsfcState* State);
+	void CreatePlan(unsigned int RelationIndex, vector<unsigned int>& Plan);
+	void CreatePlan(vector<unsigned int>& RelationIndex, vector<unsigned int>& Plan);
 
 	//bool CalculateStateSize();
 	//void CompareStates(hsfcState* State1, hsfcState* State2);
@@ -68,12 +73,20 @@ public:
 	unsigned int* LegalToRole;
 	unsigned int* DoesToRole;
 	unsigned int* SeesToRole;
+	vector<hsfcGoalEntry> GoalTable;
 
+	unsigned int NumRoles;
 	unsigned int MaxRelationSize;
 
 protected:
 
 private:
+	void ClearExists(hsfcState* State, unsigned int Index);
+	void MarkDirty(hsfcState* State, unsigned int Index);
+	void AddRoleLegal(hsfcState* State, unsigned int RelationID);
+	void SwapBuffers(hsfcState* State, unsigned int Index1, unsigned int Index2);
+	unsigned int ArenaAlign(unsigned int Offset);
+	bool LayoutArena();
 
 	hsfcLexicon* Lexicon;
 	hsfcDomainManager* DomainManager;
@@ -84,9 +97,47 @@ private:
 	vector<hsfcTuple> Initial;
 	vector<hsfcReference> Next;
 
+	// Stratum dependencies for skipping unchanged strata
+	unsigned int NumStrata;
+	vector< vector<unsigned int> > StratumInput;
+	vector< vector<unsigned int> > StratumOutput;
+	vector<bool> StratumRigid;
+	vector<bool> Calculated;
+	vector<bool> Transferred;
+	vector<unsigned int> PartPermanentCount;
+
 	unsigned int NumRelationLists;
 	unsigned int StateSize;
 
+	// The legal relation is also kept partitioned by role
+	unsigned int NumLegalRoles;
+	unsigned int RoleLegalCapacity;
+
+	// Layout of the state arena shared by every state
+	// [pointer tables, rigids][copied counts and exists][relation lists]
+	unsigned int ArenaSize;
+	unsigned int ArenaCopyOffset;
+	unsigned int ArenaListOffset;
+	unsigned int RelationIDTableOffset;
+	unsigned int RelationExistsTableOffset;
+	unsigned int RelationIDSortedTableOffset;
+	unsigned int MaxNumRelationsOffset;
+	unsigned int NumRelationsOffset;
+	unsigned int RelationChangedOffset;
+	unsigned int StratumValidOffset;
+	unsigned int DirtyRelationOffset;
+	unsigned int RelationDirtyOffset;
+	unsigned int NextSwappedOffset;
+	unsigned int RoleLegalTableOffset;
+	unsigned int NumRoleLegalsOffset;
+	unsigned int RoleLegalOffset;
+	vector<bool> FullRigid;
+	vector<bool> NextSwappable;
+	vector<unsigned int> RelationCapacity;
+	vector<unsigned int> RelationIDOffset;
+	vector<unsigned int> RelationExistsOffset;
+	vector<unsigned int> RelationIDSortedOffset;
+
 };
 
 
@@ -60,14 +60,68 @@ void PyHSFCException::translate(const std::exception& e)
 }
 
 
+/*****************************************************************************************
+ * Player, Move and Fluent are light-weight handles that refer back into the game that
+ * created them, so they must not outlive it. The python versions hold the handle along
+ * with the python Game or State object that produced it, which keeps the game alive for
+ * as long as any handle is still reachable from python. The comparisons take the derived
+ * type since that is the one registered with python.
+ *****************************************************************************************/
+
+template<typename Derived, typename T>
+struct PyHandle
+{
+    PyHandle(const T& handle, const py::object& owner);
+
+    std::string tostring() const;
+    std::size_t hash_value() const;
+    bool operator==(const Derived& other) const;
+    bool operator!=(const Derived& other) const;
+
+    T handle_;
+    py::object owner_;
+};
+
+template<typename Derived, typename T>
+PyHandle<Derived,T>::PyHandle(const T& handle, const py::object& owner) :
+    handle_(handle), owner_(owner)
+{ }
+
+template<typename Derived, typename T>
+std::string PyHandle<Derived,T>::tostring() const
+{
+    return handle_.tostring();
+}
+
+template<typename Derived, typename T>
+std::size_t PyHandle<Derived,T>::hash_value() const
+{
+    return handle_.hash_value();
+}
+
+template<typename Derived, typename T>
+bool PyHandle<Derived,T>::operator==(const Derived& other) const
+{
+    return handle_ == other.handle_;
+}
+
+template<typename Derived, typename T>
+bool PyHandle<Derived,T>::operator!=(const Derived& other) const
+{
+    return handle_ != other.handle_;
+}
+
+
 /*****************************************************************************************
  * Support for python Player.
  *****************************************************************************************/
 
-struct PyPlayer
+struct PyPlayer : public PyHandle<PyPlayer, Player>
 {
     /* docstrings */
     static const char* ds_class;
+
+    PyPlayer(const Player& player, const py::object& owner);
 };
 
 const char* PyPlayer::ds_class =
@@ -76,14 +130,20 @@ are not created explicitly but are instead created through queries to Game\n\
 and State objects.\n\n\
 Use the str(object) function to return a printable name of the player.";
 
+PyPlayer::PyPlayer(const Player& player, const py::object& owner) :
+    PyHandle<PyPlayer, Player>(player, owner)
+{ }
+
 /*****************************************************************************************
  * Support for python Move.
  *****************************************************************************************/
 
-struct PyMove
+struct PyMove : public PyHandle<PyMove, Move>
 {
     /* docstrings */
     static const char* ds_class;
+
+    PyMove(const Move& move, const py::object& owner);
 };
 
 const char* PyMove::ds_class =
@@ -91,15 +151,21 @@ const char* PyMove::ds_class =
 not created explicitly but are instead created through queries to State objects.\n\n\
 Use the str(object) function to return a GDL formatted string of the action.";
 
+PyMove::PyMove(const Move& move, const py::object& owner) :
+    PyHandle<PyMove, Move>(move, owner)
+{ }
+
 
 /*****************************************************************************************
  * Support for python Fluent.
  *****************************************************************************************/
 
-struct PyFluent
+struct PyFluent : public PyHandle<PyFluent, Fluent>
 {
     /* docstrings */
     static const char* ds_class;
+
+    PyFluent(const Fluent& fluent, const py::object& owner);
 };
 
 const char* PyFluent::ds_class =
@@ -107,6 +173,10 @@ const char* PyFluent::ds_class =
 not created explicitly but are instead created through queries to State objects.\n\n\
 Use the str(object) function to return a GDL formatted string of the fluent.";
 
+PyFluent::PyFluent(const Fluent& fluent, const py::object& owner) :
+    PyHandle<PyFluent, Fluent>(fluent, owner)
+{ }
+
 
 /*****************************************************************************************
  * Support for python Game.
@@ -126,7 +196,7 @@ public:
            const std::string& gdlfilename);
 
     /* Returns the list of players */
-    py::list players();
+    static py::list players(py::back_reference<PyGame&> self);
 };
 
 const char* PyGame::ds_class =
@@ -154,14 +224,14 @@ PyGame::PyGame(const std::string& gdldescription,
         Game::initialise(boost::filesystem::path(gdlfilename));
 }
 
-py::list PyGame::players()
+py::list PyGame::players(py::back_reference<PyGame&> self)
 {
     py::list pylist;
     std::vector<Player> plyrs;
-    Game::players(std::back_inserter(plyrs));
+    self.get().Game::players(std::back_inserter(plyrs));
     BOOST_FOREACH(const Player& p, plyrs)
     {
-        pylist.append(p);
+        pylist.append(PyPlayer(p, self.source()));
     }
     return pylist;
 }
@@ -183,11 +253,12 @@ public:
     static const char* ds_fluents;
     static const char* ds_goals;
 
-    py::dict legals();
-    py::list joints();
-    py::dict goals();
-    py::dict playout();
-    py::list fluents();
+    /* Queries returning handles take the python State so the handles can keep it alive */
+    static py::dict legals(py::back_reference<PyState&> self);
+    static py::list joints(py::back_reference<PyState&> self);
+    static py::dict goals(py::back_reference<PyState&> self);
+    static py::dict playout(py::back_reference<PyState&> self);
+    static py::list fluents(py::back_reference<PyState&> self);
     void play1(const boost::python::dict& mydict);
     void play2(const boost::python::list& mylist);
 
@@ -228,27 +299,27 @@ PyState::PyState(PyGame& game, const PortableState& ps) : State(game, ps)
 PyState::PyState(const PyState& other) : State(other)
 { }
 
-py::dict PyState::legals()
+py::dict PyState::legals(py::back_reference<PyState&> self)
 {
     py::dict pydict;
-    boost::unordered_map<Player, std::vector<Move> >lgls = State::legals();
+    boost::unordered_map<Player, std::vector<Move> >lgls = self.get().State::legals();
     typedef std::pair<Player, std::vector<Move> > pmvs_t;
     BOOST_FOREACH(const pmvs_t& pmvs, lgls)
     {
         py::list pylist;
         BOOST_FOREACH(const Move& mv, pmvs.second)
         {
-            pylist.append(mv);
+            pylist.append(PyMove(mv, self.source()));
         }
-        pydict[pmvs.first] = pylist;
+        pydict[PyPlayer(pmvs.first, self.source())] = pylist;
     }
     return pydict;
 }
 
-py::list PyState::joints()
+py::list PyState::joints(py::back_reference<PyState&> self)
 {
     py::list pylist;
-    std::vector<JointMove> jts = State::joints();
+    std::vector<JointMove> jts = self.get().State::joints();
 
     BOOST_FOREACH(const JointMove& jm, jts)
     {
@@ -256,7 +327,7 @@ py::list PyState::joints()
         typedef std::pair<Player, Move> pm_t;
         BOOST_FOREACH(const pm_t& pm, jm)
         {
-            pydict[pm.first] = pm.second;
+            pydict[PyPlayer(pm.first, self.source())] = PyMove(pm.second, self.source());
         }
         pylist.append(pydict);
     }
@@ -264,38 +335,38 @@ py::list PyState::joints()
 }
 
 
-py::dict PyState::goals()
+py::dict PyState::goals(py::back_reference<PyState&> self)
 {
     py::dict pydict;
-    boost::unordered_map<Player, unsigned int> pgs = State::goals();
+    boost::unordered_map<Player, unsigned int> pgs = self.get().State::goals();
     typedef std::pair<Player, unsigned int > pg_t;
     BOOST_FOREACH(const pg_t& pg, pgs)
     {
-        pydict[pg.first] = pg.second;
+        pydict[PyPlayer(pg.first, self.source())] = pg.second;
     }
     return pydict;
 }
 
-py::dict PyState::playout()
+py::dict PyState::playout(py::back_reference<PyState&> self)
 {
     py::dict pydict;
-    boost::unordered_map<Player, unsigned int> pgs = State::playout();
+    boost::unordered_map<Player, unsigned int> pgs = self.get().State::playout();
     typedef std::pair<Player, unsigned int > pg_t;
     BOOST_FOREACH(const pg_t& pg, pgs)
     {
-        pydict[pg.first] = pg.second;
+        pydict[PyPlayer(pg.first, self.source())] = pg.second;
     }
     return pydict;
 }
 
-py::list PyState::fluents()
+py::list PyState::fluents(py::back_reference<PyState&> self)
 {
     py::list pylist;
-    std::vector<Fluent> fls = State::fluents();
+    std::vector<Fluent> fls = self.get().State::fluents();
 
     BOOST_FOREACH(const Fluent& fl, fls)
     {
-        pylist.append(fl);
+        pylist.append(PyFluent(fl, self.source()));
     }
     return pylist;
 }
@@ -311,9 +382,9 @@ void PyState::play2(const boost::python::list& mylist)
     for (unsigned int i = 0; i < py::len(mylist); ++i)
     {
         py::object pm_pair = mylist[i];
-        Player p = py::extract<Player>(pm_pair[0]);
-        Move m = py::extract<Move>(pm_pair[1]);
-        pmvs.push_back(std::make_pair(p, m));
+        const PyPlayer& p = py::extract<const PyPlayer&>(pm_pair[0]);
+        const PyMove& m = py::extract<const PyMove&>(pm_pair[1]);
+        pmvs.push_back(std::make_pair(p.handle_, m.handle_));
     }
     State::play(pmvs.begin(), pmvs.end());
 }
@@ -381,31 +452,31 @@ BOOST_PYTHON_MODULE(pyhsfc)
 
     py::register_exception_translator<std::exception>(&PyHSFCException::translate);
 
-    py::class_<Player>
+    py::class_<PyPlayer>
         ("Player", PyPlayer::ds_class, py::no_init)
-        .def(py::self_ns::str(py::self_ns::self))
-        .def("__repr__", &Player::tostring)
-        .def("__hash__", &Player::hash_value)
-        .def("__eq__", &Player::operator==)
-        .def("__ne__", &Player::operator!=)
+        .def("__str__", &PyPlayer::tostring)
+        .def("__repr__", &PyPlayer::tostring)
+        .def("__hash__", &PyPlayer::hash_value)
+        .def("__eq__", &PyPlayer::operator==)
+        .def("__ne__", &PyPlayer::operator!=)
         ;
 
-    py::class_<Move>
+    py::class_<PyMove>
         ("Move", PyMove::ds_class, py::no_init)
-        .def(py::self_ns::str(py::self_ns::self))
-        .def("__repr__", &Move::tostring)
-        .def("__hash__", &Move::hash_value)
-        .def("__eq__", &Move::operator==)
-        .def("__ne__", &Move::operator!=)
+        .def("__str__", &PyMove::tostring)
+        .def("__repr__", &PyMove::tostring)
+        .def("__hash__", &PyMove::hash_value)
+        .def("__eq__", &PyMove::operator==)
+        .def("__ne__", &PyMove::operator!=)
         ;
 
-    py::class_<Fluent>
+    py::class_<PyFluent>
         ("Fluent", PyFluent::ds_class, py::no_init)
-        .def(py::self_ns::str(py::self_ns::self))
-        .def("__repr__", &Fluent::tostring)
-        .def("__hash__", &Fluent::hash_value)
-        .def("__eq__", &Fluent::operator==)
-        .def("__ne__", &Fluent::operator!=)
+        .def("__str__", &PyFluent::tostring)
+        .def("__repr__", &PyFluent::tostring)
+        .def("__hash__", &PyFluent::hash_value)
+        .def("__eq__", &PyFluent::operator==)
+        .def("__ne__", &PyFluent::operator!=)
         ;
 
     py::class_<PyGame,boost::noncopyable>
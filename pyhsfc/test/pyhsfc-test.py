@@ -2,6 +2,7 @@
 
 import tempfile
 import unittest
+import weakref
 from pyhsfc import *
 
 #-------------------------------------------------------------
@@ -313,6 +314,35 @@ class TictactoeTest(unittest.TestCase):
         self.assertFalse(pstate1 == pstate3)
         self.assertFalse(pstate1 != pstate2)
 
+    #-----------------------------
+    # Players, moves and fluents keep their game alive after
+    # the Game and State objects have been dropped.
+    #-----------------------------
+    def test_handles_outlive_game(self):
+        global g_ttt
+        game = Game(gdl=g_ttt)
+        state = State(game)
+        players = game.players()
+        legals = state.legals()
+        fluents = state.fluents()
+        gameref = weakref.ref(game)
+        stateref = weakref.ref(state)
+        del game
+        del state
+
+        self.assertTrue(gameref() is not None)
+        self.assertTrue(stateref() is not None)
+        self.assertEqual(sorted(str(p) for p in players), ["oplayer", "xplayer"])
+        xplayer = next(p for p in players if str(p) == "xplayer")
+        self.assertEqual(str(legals[xplayer][0]), "(mark 1 1)")
+        self.assertEqual(len(fluents), 10)
+
+        del players
+        del xplayer
+        self.assertTrue(gameref() is None)
+        del legals
+        del fluents
+        self.assertTrue(stateref() is None)
 
 #-----------------------------
 # main